@@ -0,0 +1,463 @@
+// allocator.cpp
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Kinds of object tracked by a SlabAllocator
+enum AllocKind {
+    ALLOC_SCOPE,
+    ALLOC_FUNCTION,
+    ALLOC_OTHER,
+    ALLOC_KIND_COUNT
+};
+
+// Snapshot of a SlabAllocator's usage
+struct AllocationStats {
+    size_t bytes;                          // Bytes currently allocated, including block headers
+    size_t peakBytes;                      // High-water mark of bytes since the last reset, sampled
+                                           // when a thread refills its cache and when stats are read
+    size_t slabBytes;                      // Bytes reserved from the system for slabs
+    size_t liveCounts[ALLOC_KIND_COUNT];   // Live objects by kind
+    size_t totalCounts[ALLOC_KIND_COUNT];  // Allocations by kind since the last reset
+};
+
+// Size-class slab allocator owned by one runtime.
+//
+// Small blocks are carved from 64 KB slabs and recycled through per-size-class
+// free lists. Each thread keeps a cache of free blocks and usage counters for
+// each of the last few allocators it used, so allocation and release normally
+// take no lock and do no atomic read-modify-write, even when a thread switches
+// between runtimes. getStats() sums the counters of every cache. A cache is
+// handed back to its allocator's central lists when the thread exits or needs
+// the slot for another allocator. reset() returns every slab at once; all
+// objects must have been destroyed first.
+class SlabAllocator {
+public:
+    SlabAllocator() : id_(nextId()), cursor_(nullptr), limit_(nullptr), retired_(), peakBytes_(0), slabBytes_(0) {
+        for (size_t i = 0; i < CLASS_COUNT; ++i) {
+            central_[i] = nullptr;
+        }
+        Registry& allocators = registry();
+        std::lock_guard<std::mutex> registryLock(allocators.mutex);
+        allocators.live[id_.load(std::memory_order_relaxed)] = this;
+    }
+
+    ~SlabAllocator() {
+        {
+            Registry& allocators = registry();
+            std::lock_guard<std::mutex> registryLock(allocators.mutex);
+            allocators.live.erase(id_.load(std::memory_order_relaxed));
+        }
+        releaseSlabs();
+    }
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    // Allocate a block of at least size bytes for an object of the given kind
+    void* allocate(size_t size, AllocKind kind) {
+        size_t sizeClass = classFor(size + sizeof(BlockHeader));
+        ThreadCache& cache = threadCache();
+        BlockHeader* header;
+        if (sizeClass == LARGE_CLASS) {
+            header = static_cast<BlockHeader*>(::operator new(size + sizeof(BlockHeader)));
+            recordAllocation(cache, size + sizeof(BlockHeader), kind);
+        }
+        else {
+            header = static_cast<BlockHeader*>(allocateSmall(cache, sizeClass));
+            recordAllocation(cache, CLASS_SIZES[sizeClass], kind);
+        }
+        header->owner = this;
+        header->size = static_cast<uint32_t>(size);
+        header->sizeClass = static_cast<uint16_t>(sizeClass);
+        header->kind = static_cast<uint16_t>(kind);
+        return header + 1;
+    }
+
+    // Allocate from the global heap with the same header, so release() works for both
+    static void* allocateGlobal(size_t size) {
+        BlockHeader* header = static_cast<BlockHeader*>(::operator new(size + sizeof(BlockHeader)));
+        header->owner = nullptr;
+        header->size = static_cast<uint32_t>(size);
+        header->sizeClass = LARGE_CLASS;
+        header->kind = ALLOC_OTHER;
+        return header + 1;
+    }
+
+    // Free a block from allocate() or allocateGlobal()
+    static void release(void* pointer) {
+        if (pointer == nullptr) {
+            return;
+        }
+        BlockHeader* header = static_cast<BlockHeader*>(pointer) - 1;
+        if (header->owner == nullptr) {
+            ::operator delete(header);
+        }
+        else {
+            header->owner->deallocate(header);
+        }
+    }
+
+    // Return every slab to the system; all objects must already be destroyed
+    void reset() {
+        // Blocks and counts still cached by threads belong to the old slabs; a new ID makes them drop those
+        Registry& allocators = registry();
+        std::lock_guard<std::mutex> registryLock(allocators.mutex);
+        std::lock_guard<std::mutex> lock(mutex_);
+        releaseSlabs();
+        allocators.live.erase(id_.load(std::memory_order_relaxed));
+        id_.store(nextId(), std::memory_order_release);
+        allocators.live[id_.load(std::memory_order_relaxed)] = this;
+        for (size_t i = 0; i < CLASS_COUNT; ++i) {
+            central_[i] = nullptr;
+        }
+        cursor_ = limit_ = nullptr;
+        caches_.clear();
+        retired_ = Counters();
+        peakBytes_ = 0;
+    }
+
+    // Get a snapshot of the allocator's usage
+    AllocationStats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        AllocationStats stats;
+        stats.bytes = retired_.bytes;
+        for (size_t i = 0; i < ALLOC_KIND_COUNT; ++i) {
+            stats.liveCounts[i] = retired_.liveCounts[i];
+            stats.totalCounts[i] = retired_.totalCounts[i];
+        }
+        for (const ThreadCache* cache : caches_) {
+            stats.bytes += cache->bytes.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < ALLOC_KIND_COUNT; ++i) {
+                stats.liveCounts[i] += cache->liveCounts[i].load(std::memory_order_relaxed);
+                stats.totalCounts[i] += cache->totalCounts[i].load(std::memory_order_relaxed);
+            }
+        }
+        peakBytes_ = std::max(peakBytes_, stats.bytes);
+        stats.peakBytes = peakBytes_;
+        stats.slabBytes = slabBytes_;
+        return stats;
+    }
+
+private:
+    // Precedes every block; keeps the payload 16-byte aligned
+    struct BlockHeader {
+        SlabAllocator* owner; // nullptr for global allocations
+        uint32_t size;        // Requested payload size
+        uint16_t sizeClass;   // Index into CLASS_SIZES, or LARGE_CLASS
+        uint16_t kind;        // AllocKind
+    };
+
+    // Link stored in a free block
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static constexpr size_t CLASS_COUNT = 5;
+    static constexpr size_t CLASS_SIZES[CLASS_COUNT] = { 32, 64, 128, 256, 512 };
+    static constexpr size_t LARGE_CLASS = 0xffff;
+    static constexpr size_t SLAB_SIZE = 64 * 1024;
+    static constexpr size_t BATCH = 32; // Blocks moved between a thread cache and the central lists
+    static constexpr size_t CACHE_SLOTS = 8; // Allocators a thread caches for at once
+
+    // Usage counts of caches that were handed back
+    struct Counters {
+        size_t bytes;
+        size_t liveCounts[ALLOC_KIND_COUNT];
+        size_t totalCounts[ALLOC_KIND_COUNT];
+    };
+
+    // Free blocks and usage counts one thread holds for one allocator. The
+    // counts are written only by that thread and read by getStats(); a block
+    // freed on another thread than it was allocated on makes them wrap, but
+    // their sum over all caches stays exact.
+    struct ThreadCache {
+        uint64_t owner;            // ID of the allocator, or 0 when unused
+        SlabAllocator* allocator;  // That allocator; followed only while its ID is live
+        FreeBlock* lists[CLASS_COUNT];
+        size_t lengths[CLASS_COUNT];
+        std::atomic<size_t> bytes;
+        std::atomic<size_t> liveCounts[ALLOC_KIND_COUNT];
+        std::atomic<size_t> totalCounts[ALLOC_KIND_COUNT];
+    };
+
+    // One thread's caches, each for a different allocator
+    struct ThreadCaches {
+        ThreadCache slots[CACHE_SLOTS];
+        size_t last;   // Slot used last, checked first
+        size_t victim; // Next slot handed back when all are in use
+
+        // Hand the blocks back when the thread exits
+        ~ThreadCaches() {
+            for (ThreadCache& cache : slots) {
+                flush(cache);
+            }
+        }
+    };
+
+    // Live allocators by ID, so a thread cache can find the allocator its blocks
+    // belong to. Locked before any allocator's mutex.
+    struct Registry {
+        std::mutex mutex;
+        std::map<uint64_t, SlabAllocator*> live;
+    };
+
+    // Never destroyed, since thread caches flush into it while threads exit
+    static Registry& registry() {
+        static Registry* allocators = new Registry();
+        return *allocators;
+    }
+
+    // Smallest size class holding size bytes
+    static size_t classFor(size_t size) {
+        for (size_t i = 0; i < CLASS_COUNT; ++i) {
+            if (size <= CLASS_SIZES[i]) {
+                return i;
+            }
+        }
+        return LARGE_CLASS;
+    }
+
+    // Unique ID per allocator lifetime; reset() takes a new one to invalidate thread caches
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> counter(1);
+        return counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // This thread's cache for this allocator
+    ThreadCache& threadCache() {
+        static thread_local ThreadCaches caches = {};
+        uint64_t id = id_.load(std::memory_order_acquire);
+        ThreadCache& cache = caches.slots[caches.last];
+        if (cache.owner == id) {
+            return cache;
+        }
+        return findCache(caches, id);
+    }
+
+    // Find this thread's cache for the allocator with the given ID, taking a free
+    // slot, or handing one back, if there is none yet. Registering a new cache
+    // takes only this allocator's lock.
+    ThreadCache& findCache(ThreadCaches& caches, uint64_t id) {
+        size_t slot = CACHE_SLOTS;
+        for (size_t i = 0; i < CACHE_SLOTS; ++i) {
+            ThreadCache& cache = caches.slots[i];
+            if (cache.owner == id) {
+                caches.last = i;
+                return cache;
+            }
+            // Left over from before a reset of this allocator, or from a destroyed one at the same address
+            if (cache.owner != 0 && cache.allocator == this) {
+                clear(cache);
+            }
+            if (cache.owner == 0 && slot == CACHE_SLOTS) {
+                slot = i;
+            }
+        }
+        if (slot == CACHE_SLOTS) {
+            slot = caches.victim;
+            caches.victim = (caches.victim + 1) % CACHE_SLOTS;
+            flush(caches.slots[slot]);
+        }
+
+        ThreadCache& cache = caches.slots[slot];
+        cache.owner = id;
+        cache.allocator = this;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            caches_.push_back(&cache);
+        }
+        caches.last = slot;
+        return cache;
+    }
+
+    // Return a thread cache's blocks and counts to the allocator they came from and empty it.
+    // Blocks of a destroyed or reset allocator went with its slabs and are dropped.
+    static void flush(ThreadCache& cache) {
+        if (cache.owner != 0) {
+            Registry& allocators = registry();
+            std::lock_guard<std::mutex> registryLock(allocators.mutex);
+            auto it = allocators.live.find(cache.owner);
+            if (it != allocators.live.end()) {
+                SlabAllocator* owner = it->second;
+                std::lock_guard<std::mutex> lock(owner->mutex_);
+                for (size_t i = 0; i < CLASS_COUNT; ++i) {
+                    while (cache.lists[i] != nullptr) {
+                        FreeBlock* block = cache.lists[i];
+                        cache.lists[i] = block->next;
+                        block->next = owner->central_[i];
+                        owner->central_[i] = block;
+                    }
+                }
+                owner->retired_.bytes += cache.bytes.load(std::memory_order_relaxed);
+                for (size_t i = 0; i < ALLOC_KIND_COUNT; ++i) {
+                    owner->retired_.liveCounts[i] += cache.liveCounts[i].load(std::memory_order_relaxed);
+                    owner->retired_.totalCounts[i] += cache.totalCounts[i].load(std::memory_order_relaxed);
+                }
+                owner->caches_.erase(std::find(owner->caches_.begin(), owner->caches_.end(), &cache));
+            }
+        }
+        clear(cache);
+    }
+
+    // Empty a thread cache that no allocator lists any more
+    static void clear(ThreadCache& cache) {
+        cache.owner = 0;
+        cache.allocator = nullptr;
+        for (size_t i = 0; i < CLASS_COUNT; ++i) {
+            cache.lists[i] = nullptr;
+            cache.lengths[i] = 0;
+        }
+        cache.bytes.store(0, std::memory_order_relaxed);
+        for (size_t i = 0; i < ALLOC_KIND_COUNT; ++i) {
+            cache.liveCounts[i].store(0, std::memory_order_relaxed);
+            cache.totalCounts[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Fast path: pop from the thread cache, refilling it in a batch under the lock
+    void* allocateSmall(ThreadCache& cache, size_t sizeClass) {
+        if (cache.lists[sizeClass] == nullptr) {
+            refill(cache, sizeClass);
+        }
+        FreeBlock* block = cache.lists[sizeClass];
+        cache.lists[sizeClass] = block->next;
+        --cache.lengths[sizeClass];
+        return block;
+    }
+
+    // Move up to BATCH blocks from the central list, or a fresh slab, into the cache
+    void refill(ThreadCache& cache, size_t sizeClass) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        samplePeak();
+        size_t blockSize = CLASS_SIZES[sizeClass];
+        for (size_t i = 0; i < BATCH; ++i) {
+            FreeBlock* block = central_[sizeClass];
+            if (block != nullptr) {
+                central_[sizeClass] = block->next;
+            }
+            else {
+                if (cursor_ == nullptr || static_cast<size_t>(limit_ - cursor_) < blockSize) {
+                    if (i > 0) {
+                        break;
+                    }
+                    newSlab();
+                }
+                block = reinterpret_cast<FreeBlock*>(cursor_);
+                cursor_ += blockSize;
+            }
+            block->next = cache.lists[sizeClass];
+            cache.lists[sizeClass] = block;
+            ++cache.lengths[sizeClass];
+        }
+    }
+
+    // Reserve a new slab for bump allocation
+    void newSlab() {
+        cursor_ = static_cast<char*>(::operator new(SLAB_SIZE));
+        limit_ = cursor_ + SLAB_SIZE;
+        slabs_.push_back(cursor_);
+        slabBytes_ += SLAB_SIZE;
+    }
+
+    // Return a block to the thread cache, spilling a batch to the central list when it grows
+    void deallocate(BlockHeader* header) {
+        AllocKind kind = static_cast<AllocKind>(header->kind);
+        size_t sizeClass = header->sizeClass;
+        ThreadCache& cache = threadCache();
+        if (sizeClass == LARGE_CLASS) {
+            recordRelease(cache, header->size + sizeof(BlockHeader), kind);
+            ::operator delete(header);
+            return;
+        }
+        recordRelease(cache, CLASS_SIZES[sizeClass], kind);
+
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(header);
+        block->next = cache.lists[sizeClass];
+        cache.lists[sizeClass] = block;
+        if (++cache.lengths[sizeClass] > 2 * BATCH) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < BATCH; ++i) {
+                FreeBlock* spilled = cache.lists[sizeClass];
+                cache.lists[sizeClass] = spilled->next;
+                spilled->next = central_[sizeClass];
+                central_[sizeClass] = spilled;
+            }
+            cache.lengths[sizeClass] -= BATCH;
+        }
+    }
+
+    // Add to a count written only by this thread: a plain load and store, not a locked read-modify-write
+    static void add(std::atomic<size_t>& count, size_t delta) {
+        count.store(count.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    static void recordAllocation(ThreadCache& cache, size_t bytes, AllocKind kind) {
+        add(cache.bytes, bytes);
+        add(cache.liveCounts[kind], 1);
+        add(cache.totalCounts[kind], 1);
+    }
+
+    static void recordRelease(ThreadCache& cache, size_t bytes, AllocKind kind) {
+        add(cache.bytes, 0 - bytes);
+        add(cache.liveCounts[kind], size_t(0) - 1);
+    }
+
+    // Raise peakBytes_ to the bytes currently allocated; mutex_ must be held
+    void samplePeak() {
+        size_t bytes = retired_.bytes;
+        for (const ThreadCache* cache : caches_) {
+            bytes += cache->bytes.load(std::memory_order_relaxed);
+        }
+        peakBytes_ = std::max(peakBytes_, bytes);
+    }
+
+    void releaseSlabs() {
+        for (char* slab : slabs_) {
+            ::operator delete(slab);
+        }
+        slabs_.clear();
+        slabBytes_ = 0;
+    }
+
+    std::atomic<uint64_t> id_;
+    mutable std::mutex mutex_; // Guards the members below
+    std::vector<char*> slabs_;
+    FreeBlock* central_[CLASS_COUNT];
+    char* cursor_;
+    char* limit_;
+
+    std::vector<ThreadCache*> caches_; // Thread caches holding counts for this allocator
+    Counters retired_;
+    mutable size_t peakBytes_;
+    size_t slabBytes_;
+};
+
+// Base for objects that can live in a SlabAllocator:
+// "new (heap) T(...)" allocates from heap, plain "new T(...)" from the global
+// heap, and "delete" returns the block to wherever it came from.
+template <AllocKind Kind>
+struct SlabAllocated {
+    static void* operator new(size_t size) {
+        return SlabAllocator::allocateGlobal(size);
+    }
+
+    static void* operator new(size_t size, SlabAllocator& heap) {
+        return heap.allocate(size, Kind);
+    }
+
+    static void operator delete(void* pointer) {
+        SlabAllocator::release(pointer);
+    }
+
+    // Used only if a constructor throws during "new (heap) T(...)"
+    static void operator delete(void* pointer, SlabAllocator&) {
+        SlabAllocator::release(pointer);
+    }
+};
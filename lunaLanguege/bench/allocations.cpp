@@ -0,0 +1,70 @@
+// allocations.cpp
+//
+// Real heap allocations per call of a helper-function-heavy script:
+//
+//     func inner(x) return x end
+//     func helper(a, b) inner(x = b) return inner(x = a) end
+//     helper(a = "1", b = "2")
+//
+// Global operator new is replaced with a counting version, so every
+// allocation is seen, including std::map nodes and string buffers that the
+// runtime's own ExecutionStats do not track. Slab allocator counts show how
+// many scopes and functions the calls took from the runtime heap.
+
+#include <cstdlib>
+#include <new>
+#include "bench.h"
+
+static size_t allocationCount = 0;
+static size_t allocationBytes = 0;
+
+void* operator new(size_t size) {
+    ++allocationCount;
+    allocationBytes += size;
+    void* pointer = std::malloc(size != 0 ? size : 1);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+int main(int argc, char* argv[]) {
+    long long calls = iterationsArg(argc, argv, 1000000);
+
+    AstBuilder ast;
+    Runtime runtime;
+    ast.declare(runtime, "inner", ast.block({ ast.returnStatement(ast.identifier("x")) }));
+    ast.declare(runtime, "helper", ast.block({
+        ast.expressionStatement(ast.call("inner", { { "x", ast.identifier("b") } })),
+        ast.returnStatement(ast.call("inner", { { "x", ast.identifier("a") } }))
+    }));
+    AstNode* call = ast.call("helper", { { "a", ast.literal("1") }, { "b", ast.literal("2") } });
+
+    Scope* globals = runtime.getGlobals();
+    AllocationStats before = runtime.getAllocationStats();
+    size_t startCount = allocationCount;
+    size_t startBytes = allocationBytes;
+    auto start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < calls; ++i) {
+        runtime.evaluateExpression(call, globals);
+    }
+    double ms = millisecondsSince(start);
+    AllocationStats after = runtime.getAllocationStats();
+
+    // Each helper call makes two nested calls of inner, one of them a tail call
+    std::cout << "allocations, " << calls << " helper calls (" << 3 * calls << " Luna calls)" << std::endl;
+    std::cout << "  operator new: " << double(allocationCount - startCount) / calls << " allocations, "
+        << double(allocationBytes - startBytes) / calls << " bytes per helper call" << std::endl;
+    std::cout << "  runtime heap: " << double(after.totalCounts[ALLOC_SCOPE] - before.totalCounts[ALLOC_SCOPE]) / calls << " scopes, "
+        << double(after.totalCounts[ALLOC_FUNCTION] - before.totalCounts[ALLOC_FUNCTION]) / calls << " functions per helper call" << std::endl;
+    std::cout << "  time: " << ms * 1e6 / calls << " ns per helper call" << std::endl;
+    return 0;
+}
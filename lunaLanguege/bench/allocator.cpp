@@ -0,0 +1,90 @@
+// allocator.cpp
+//
+// Multithreaded throughput of Scope and Function allocation, comparing:
+//
+//     global       plain new, i.e. the global allocator
+//     per-runtime  new (runtime.getHeap()), one runtime per thread
+//     shared       new (runtime.getHeap()), every thread on one runtime
+//     alternating  new (runtime.getHeap()), two runtimes per thread, switching
+//                  on every allocation
+//
+// Each thread repeatedly allocates a batch of objects and frees them again.
+// Usage: allocator [rounds per thread] [max threads]
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include "bench.h"
+
+enum Mode {
+    MODE_GLOBAL,
+    MODE_PER_RUNTIME,
+    MODE_SHARED,
+    MODE_ALTERNATING
+};
+
+const size_t BATCH_SIZE = 64;
+
+// Allocate and free rounds batches of scopes and functions, taking scopes from
+// first and functions from second; nullptr means the global allocator
+void churn(SlabAllocator* first, SlabAllocator* second, long long rounds) {
+    Scope* scopes[BATCH_SIZE / 2];
+    Function* functions[BATCH_SIZE / 2];
+    for (long long round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < BATCH_SIZE / 2; ++i) {
+            scopes[i] = first != nullptr ? new (*first) Scope() : new Scope();
+            functions[i] = second != nullptr ? new (*second) Function("f", nullptr) : new Function("f", nullptr);
+        }
+        for (size_t i = 0; i < BATCH_SIZE / 2; ++i) {
+            delete scopes[i];
+            delete functions[i];
+        }
+    }
+}
+
+// Millions of allocations per second across all threads
+double throughput(Mode mode, size_t threadCount, long long rounds) {
+    Runtime shared;
+    std::vector<std::unique_ptr<Runtime>> runtimes;
+    for (size_t i = 0; i < 2 * threadCount; ++i) {
+        runtimes.emplace_back(new Runtime());
+    }
+
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+        SlabAllocator* first = mode == MODE_GLOBAL ? nullptr : mode == MODE_SHARED ? &shared.getHeap() : &runtimes[2 * i]->getHeap();
+        SlabAllocator* second = mode == MODE_ALTERNATING ? &runtimes[2 * i + 1]->getHeap() : first;
+        threads.emplace_back([first, second, rounds, &go]() {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            churn(first, second, rounds);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double ms = millisecondsSince(start);
+    return double(threadCount) * rounds * BATCH_SIZE / (ms * 1000);
+}
+
+int main(int argc, char* argv[]) {
+    long long rounds = iterationsArg(argc, argv, 200000);
+    size_t maxThreads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 8;
+
+    std::cout << "allocator throughput, " << rounds * BATCH_SIZE << " allocations per thread, "
+        << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << "  threads      global  per-runtime       shared  alternating  (M allocations/s)" << std::endl;
+    for (size_t threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+        double global = throughput(MODE_GLOBAL, threadCount, rounds);
+        double perRuntime = throughput(MODE_PER_RUNTIME, threadCount, rounds);
+        double shared = throughput(MODE_SHARED, threadCount, rounds);
+        double alternating = throughput(MODE_ALTERNATING, threadCount, rounds);
+        std::printf("  %7zu %11.1f %12.1f %12.1f %12.1f\n", threadCount, global, perRuntime, shared, alternating);
+    }
+    return 0;
+}
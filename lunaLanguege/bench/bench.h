@@ -0,0 +1,108 @@
+// bench.h
+//
+// Shared helpers for the benchmarks in this directory and the checks in
+// tests/. The parser does not build runtime ASTs yet, so programs are
+// assembled by hand.
+
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../luna.h"
+
+// Owns the nodes of hand-built ASTs
+class AstBuilder {
+public:
+    // Create a node
+    AstNode* node(AstNodeType type, const std::string& value = "", AstNode* left = nullptr, AstNode* right = nullptr) {
+        nodes_.emplace_back(new AstNode{ type, value, left, right });
+        return nodes_.back().get();
+    }
+
+    AstNode* literal(const std::string& value) {
+        return node(AST_NODE_LITERAL, value);
+    }
+
+    AstNode* identifier(const std::string& name) {
+        return node(AST_NODE_IDENTIFIER, name);
+    }
+
+    // name(param = expression, ...)
+    AstNode* call(const std::string& name, const std::vector<std::pair<std::string, AstNode*>>& args = {}) {
+        AstNode* first = nullptr;
+        for (size_t i = args.size(); i-- > 0;) {
+            first = node(AST_NODE_LITERAL, args[i].first, args[i].second, first);
+        }
+        return node(AST_NODE_FUNCTION_CALL, "", identifier(name), first);
+    }
+
+    AstNode* expressionStatement(AstNode* expression) {
+        return node(AST_NODE_EXPRESSION_STATEMENT, "", expression);
+    }
+
+    AstNode* returnStatement(AstNode* expression) {
+        return node(AST_NODE_RETURN_STATEMENT, "", expression);
+    }
+
+    // while condition do statement end; must be the last statement of its block
+    AstNode* whileStatement(AstNode* condition, AstNode* statement) {
+        return node(AST_NODE_WHILE_STATEMENT, "", condition, statement);
+    }
+
+    // loop statement end; the body block is in left
+    AstNode* loopStatement(AstNode* body) {
+        return node(AST_NODE_LOOP_STATEMENT, "", body);
+    }
+
+    // break; left is ignored when it runs, so it can carry another block
+    AstNode* breakStatement(AstNode* left = nullptr) {
+        return node(AST_NODE_BREAK_STATEMENT, "", left);
+    }
+
+    // func name ... end; body is also the next statement of the enclosing block
+    AstNode* functionDeclaration(const std::string& name, AstNode* body) {
+        return node(AST_NODE_FUNCTION_DECLARATION, "", identifier(name), body);
+    }
+
+    // Block node whose statements are chained through right
+    AstNode* block(const std::vector<AstNode*>& statements) {
+        for (size_t i = 0; i + 1 < statements.size(); ++i) {
+            statements[i]->right = statements[i + 1];
+        }
+        return node(AST_NODE_LITERAL, "", statements.empty() ? nullptr : statements[0]);
+    }
+
+    // Declare a script function in the runtime's global scope
+    void declare(Runtime& runtime, const std::string& name, AstNode* body) {
+        runtime.getGlobals()->addFunction(new (runtime.getHeap()) Function(name, body));
+    }
+
+private:
+    std::vector<std::unique_ptr<AstNode>> nodes_;
+};
+
+// Countdown used as a loop condition: true until the budget is spent
+struct Countdown {
+    static long long remaining;
+
+    static bool next() {
+        return remaining-- > 0;
+    }
+};
+
+long long Countdown::remaining = 0;
+
+// Milliseconds elapsed since start
+inline double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Iteration count from the first command-line argument, or the default
+inline long long iterationsArg(int argc, char* argv[], long long defaultIterations) {
+    return argc > 1 ? std::atoll(argv[1]) : defaultIterations;
+}
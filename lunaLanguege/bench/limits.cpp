@@ -0,0 +1,57 @@
+// limits.cpp
+//
+// Cost of execution limit checks on a call-heavy loop:
+//
+//     func step(a) return a end
+//     while next() do step(a = "x") end
+//
+// Each iteration makes a native call and a script call and takes a backedge,
+// so it charges three units of fuel. The Makefile also builds this file with
+// LUNA_NO_LIMIT_CHECKS as bench/limits_unchecked, the baseline for the overhead.
+
+#include "bench.h"
+
+// Best time of several runs, in nanoseconds per iteration
+double timeLoop(Runtime& runtime, AstNode* program, long long iterations, const ExecutionLimits& limits) {
+    runtime.setLimits(limits);
+    double best = 0;
+    for (int repeat = 0; repeat < 5; ++repeat) {
+        Countdown::remaining = iterations;
+        auto start = std::chrono::steady_clock::now();
+        runtime.run(program);
+        double ns = millisecondsSince(start) * 1e6 / iterations;
+        if (repeat == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    long long iterations = iterationsArg(argc, argv, 2000000);
+
+    AstBuilder ast;
+    Runtime runtime;
+    bindFunction<&Countdown::next>(runtime, "next");
+    ast.declare(runtime, "step", ast.block({ ast.returnStatement(ast.identifier("a")) }));
+    AstNode* program = ast.block({
+        ast.whileStatement(ast.call("next"), ast.expressionStatement(ast.call("step", { { "a", ast.literal("x") } })))
+    });
+
+    ExecutionLimits unlimited = {};
+    ExecutionLimits armed = {};
+    armed.maxInstructions = 1000ull * iterations;
+    armed.maxMilliseconds = 3600 * 1000;
+    armed.maxHeapBytes = 64 * 1024 * 1024;
+    armed.maxCallDepth = 64;
+
+#ifdef LUNA_NO_LIMIT_CHECKS
+    const char* build = "checks compiled out";
+#else
+    const char* build = "checks compiled in";
+#endif
+    std::cout << "limits (" << build << "), " << iterations << " iterations" << std::endl;
+    std::cout << "  no limits set: " << timeLoop(runtime, program, iterations, unlimited) << " ns/iteration" << std::endl;
+    std::cout << "  all limits set: " << timeLoop(runtime, program, iterations, armed) << " ns/iteration" << std::endl;
+    return 0;
+}
@@ -0,0 +1,47 @@
+// native.cpp
+//
+// Cost of calling a trivial native function compared with a script function
+// taking the same arguments:
+//
+//     add(a = "40", b = "2")    native int add(int, int)
+//     pick(a = "40", b = "2")   func pick(a, b) return a end
+//
+// Calls go through Runtime::evaluateExpression, the same path a call
+// expression in a script takes.
+
+#include "bench.h"
+
+int add(int a, int b) {
+    return a + b;
+}
+
+// Nanoseconds per call of expression
+double timeCalls(Runtime& runtime, AstNode* expression, long long calls) {
+    Scope* globals = runtime.getGlobals();
+    auto start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < calls; ++i) {
+        runtime.evaluateExpression(expression, globals);
+    }
+    return millisecondsSince(start) * 1e6 / calls;
+}
+
+int main(int argc, char* argv[]) {
+    long long calls = iterationsArg(argc, argv, 100000000);
+
+    AstBuilder ast;
+    Runtime runtime;
+    bindFunction<&add>(runtime, "add");
+    ast.declare(runtime, "pick", ast.block({ ast.returnStatement(ast.identifier("a")) }));
+
+    AstNode* nativeCall = ast.call("add", { { "a", ast.literal("40") }, { "b", ast.literal("2") } });
+    AstNode* scriptCall = ast.call("pick", { { "a", ast.literal("40") }, { "b", ast.literal("2") } });
+    if (runtime.evaluateExpression(nativeCall, runtime.getGlobals()).getValue() != "42") {
+        std::cerr << "add returned the wrong value" << std::endl;
+        return 1;
+    }
+
+    std::cout << "native calls, " << calls << " calls each" << std::endl;
+    std::cout << "  native add: " << timeCalls(runtime, nativeCall, calls) << " ns/call" << std::endl;
+    std::cout << "  script pick: " << timeCalls(runtime, scriptCall, calls) << " ns/call" << std::endl;
+    return 0;
+}
@@ -1,8 +1,12 @@
 // lexer.cpp
 
 #include <iostream>
+#include <fstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <cstdint>
 
 // Token types
 enum TokenType {
@@ -23,14 +27,169 @@ struct Token {
     std::string value;
 };
 
+// Keyword symbol IDs; keywords are interned first, in this order, by every TokenBuffer
+enum KeywordId {
+    KW_IF, KW_WHILE, KW_FUNC, KW_RETURN, KW_END, KW_TRUE, KW_FALSE, KW_NULL,
+    KW_PRINT, KW_INPUT, KW_VAR, KW_LET, KW_CONST, KW_BREAK, KW_CONTINUE,
+    KW_IMPORT, KW_EXPORT, KW_LOOP, KW_COUNT
+};
+
+static const char* const KEYWORDS[KW_COUNT] = {
+    "if", "while", "func", "return", "end", "true", "false", "null",
+    "print", "input", "var", "let", "const", "break", "continue",
+    "import", "export", "loop"
+};
+
+// Whole-input token stream stored as parallel arrays. The last token is always
+// TOKEN_EOF, and each token's text is interned once in the symbol table.
+struct TokenBuffer {
+    std::vector<TokenType> types;
+    std::vector<uint32_t> offsets; // Source offset of each token
+    std::vector<uint32_t> lengths; // Source length of each token
+    std::vector<uint32_t> symbols; // Symbol ID of each token's text
+    std::vector<std::string> symbolTable;
+    std::unordered_map<std::string, uint32_t> symbolIds;
+
+    TokenBuffer() {
+        for (const char* keyword : KEYWORDS) {
+            intern(keyword);
+        }
+    }
+
+    // Number of tokens, including the trailing EOF
+    size_t size() const {
+        return types.size();
+    }
+
+    // Get the interned text of a token
+    const std::string& text(size_t index) const {
+        return symbolTable[symbols[index]];
+    }
+
+    // Get the symbol ID for a string, adding it if it is new
+    uint32_t intern(const std::string& value) {
+        auto it = symbolIds.find(value);
+        if (it != symbolIds.end()) {
+            return it->second;
+        }
+        uint32_t id = static_cast<uint32_t>(symbolTable.size());
+        symbolTable.push_back(value);
+        symbolIds.emplace(value, id);
+        return id;
+    }
+
+    // Append a token
+    void push(TokenType type, size_t offset, size_t length, const std::string& value) {
+        types.push_back(type);
+        offsets.push_back(static_cast<uint32_t>(offset));
+        lengths.push_back(static_cast<uint32_t>(length));
+        symbols.push_back(intern(value));
+    }
+
+    // Write the buffer to a token cache file
+    bool save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        writeInt(out, static_cast<uint32_t>(symbolTable.size()));
+        for (const std::string& symbol : symbolTable) {
+            writeInt(out, static_cast<uint32_t>(symbol.size()));
+            out.write(symbol.data(), symbol.size());
+        }
+        writeInt(out, static_cast<uint32_t>(size()));
+        for (size_t i = 0; i < size(); ++i) {
+            writeInt(out, static_cast<uint32_t>(types[i]));
+            writeInt(out, offsets[i]);
+            writeInt(out, lengths[i]);
+            writeInt(out, symbols[i]);
+        }
+        return static_cast<bool>(out);
+    }
+
+    // Read a token cache file written by save
+    bool load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[sizeof(CACHE_MAGIC)];
+        if (!in.read(magic, sizeof(magic)) || std::string(magic, sizeof(magic)) != std::string(CACHE_MAGIC, sizeof(CACHE_MAGIC))) {
+            return false;
+        }
+
+        types.clear();
+        offsets.clear();
+        lengths.clear();
+        symbols.clear();
+        symbolTable.clear();
+        symbolIds.clear();
+        uint32_t symbolCount = readInt(in);
+        for (uint32_t i = 0; i < symbolCount && in; ++i) {
+            std::string symbol(readInt(in), '\0');
+            in.read(&symbol[0], symbol.size());
+            symbolIds.emplace(symbol, i);
+            symbolTable.push_back(symbol);
+        }
+        uint32_t tokenCount = readInt(in);
+        for (uint32_t i = 0; i < tokenCount && in; ++i) {
+            types.push_back(static_cast<TokenType>(readInt(in)));
+            offsets.push_back(readInt(in));
+            lengths.push_back(readInt(in));
+            symbols.push_back(readInt(in));
+        }
+
+        // Reject truncated files and caches from an incompatible keyword table
+        if (!in || types.empty() || types.back() != TOKEN_EOF || symbolTable.size() < KW_COUNT) {
+            return false;
+        }
+        for (size_t i = 0; i < size(); ++i) {
+            if (symbols[i] >= symbolTable.size()) {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < KW_COUNT; ++i) {
+            if (symbolTable[i] != KEYWORDS[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr char CACHE_MAGIC[8] = { 'L', 'U', 'N', 'A', 'T', 'O', 'K', '2' };
+
+    static void writeInt(std::ostream& out, uint32_t value) {
+        unsigned char bytes[4] = {
+            static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8),
+            static_cast<unsigned char>(value >> 16), static_cast<unsigned char>(value >> 24)
+        };
+        out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    }
+
+    static uint32_t readInt(std::istream& in) {
+        unsigned char bytes[4] = { 0, 0, 0, 0 };
+        in.read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+};
+
 // Lexer class
 class Lexer {
 public:
-    Lexer(const std::string& sourceCode) : sourceCode_(sourceCode), pos_(0) {}
+    Lexer(const std::string& sourceCode) : sourceCode_(sourceCode), pos_(0), tokenStart_(0) {}
+
+    // Tokenize the whole input up front
+    TokenBuffer tokenize() {
+        TokenBuffer buffer;
+        while (true) {
+            Token token = getNextToken();
+            buffer.push(token.type, tokenStart_, pos_ - tokenStart_, token.value);
+            if (token.type == TOKEN_EOF) {
+                return buffer;
+            }
+        }
+    }
 
     // Get the next token from the source code
     Token getNextToken() {
         skipWhitespaceAndComments();
+        tokenStart_ = pos_;
 
         // Check for end of file
         if (pos_ >= sourceCode_.size()) {
@@ -60,8 +219,7 @@ public:
         }
 
         // Error: unknown token
-        std::cerr << "Error: unknown token at position " << pos_ << std::endl;
-        exit(1);
+        throw std::runtime_error("Error: unknown token at position " + std::to_string(pos_));
     }
 
 private:
@@ -118,8 +276,7 @@ private:
             ++pos_;
         }
         if (!closed) {
-            std::cerr << "Error: Unterminated string literal\n";
-            exit(1);
+            throw std::runtime_error("Error: Unterminated string literal");
         }
         return Token{ TOKEN_STRING, value };
     }
@@ -175,11 +332,7 @@ private:
 
     // Helper functions for checking token types
     bool isKeyword(const std::string& str) {
-        static const std::vector<std::string> keywords = {
-            "if", "while", "func", "return", "end", "true", "false", "null",
-            "print", "input", "var", "let", "const", "break", "continue", "import", "export", "loop"
-        };
-        for (const auto& kw : keywords) {
+        for (const char* kw : KEYWORDS) {
             if (str == kw) return true;
         }
         return false;
@@ -187,6 +340,7 @@ private:
 
     std::string sourceCode_;
     size_t pos_;
+    size_t tokenStart_;
 };
 
 
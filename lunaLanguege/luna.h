@@ -0,0 +1,121 @@
+// luna.h
+//
+// Embedding API: expose C++ functions to Luna scripts.
+//
+//     int add(int a, int b) { return a + b; }
+//
+//     Runtime runtime;
+//     bindFunction<&add>(runtime, "add");
+//
+// Argument unpacking and return conversion are generated at compile time,
+// so a call from a script goes straight through a plain function pointer.
+// Bind native functions after Runtime::loadSnapshot, which replaces the
+// global scope and does not store native functions.
+//
+// A call with the wrong number of arguments, or with an argument that does
+// not convert to the parameter type, such as "abc" or "1.5" for an int,
+// throws std::runtime_error out of Runtime::run.
+
+#pragma once
+
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include "runtime.cpp"
+
+// Parse a whole value as a number of type T, throwing if any of it is not part of the number
+template <typename T>
+T parseNumber(const Value& value, const char* typeName) {
+    const std::string& text = value.getValue();
+    const char* end = text.data() + text.size();
+    T number;
+    std::from_chars_result result = std::from_chars(text.data(), end, number);
+    if (result.ec != std::errc() || result.ptr != end) {
+        throw std::runtime_error("Error: cannot convert \"" + text + "\" to " + typeName);
+    }
+    return number;
+}
+
+// Conversion between Luna values and C++ argument/return types
+template <typename T>
+struct ValueConverter;
+
+template <>
+struct ValueConverter<Value> {
+    static const Value& fromValue(const Value& value) { return value; }
+    static Value toValue(const Value& value) { return value; }
+};
+
+template <>
+struct ValueConverter<std::string> {
+    static const std::string& fromValue(const Value& value) { return value.getValue(); }
+    static Value toValue(const std::string& value) { return Value(value); }
+};
+
+template <>
+struct ValueConverter<bool> {
+    static bool fromValue(const Value& value) { return static_cast<bool>(value); }
+    static Value toValue(bool value) { return Value(value ? "true" : "false"); }
+};
+
+template <>
+struct ValueConverter<int> {
+    static int fromValue(const Value& value) { return parseNumber<int>(value, "int"); }
+    static Value toValue(int value) { return Value(std::to_string(value)); }
+};
+
+template <>
+struct ValueConverter<long> {
+    static long fromValue(const Value& value) { return parseNumber<long>(value, "long"); }
+    static Value toValue(long value) { return Value(std::to_string(value)); }
+};
+
+template <>
+struct ValueConverter<long long> {
+    static long long fromValue(const Value& value) { return parseNumber<long long>(value, "long long"); }
+    static Value toValue(long long value) { return Value(std::to_string(value)); }
+};
+
+template <>
+struct ValueConverter<double> {
+    static double fromValue(const Value& value) { return parseNumber<double>(value, "double"); }
+    static Value toValue(double value) { return Value(std::to_string(value)); }
+};
+
+// Thunk generated for a native function Fn with signature R(Args...)
+template <auto Fn, typename Signature = decltype(Fn)>
+struct NativeBinding;
+
+template <auto Fn, typename R, typename... Args>
+struct NativeBinding<Fn, R (*)(Args...)> {
+    static constexpr size_t arity = sizeof...(Args);
+
+    // Matches NativeThunk; args holds exactly `arity` values
+    static Value invoke(const Value* args) {
+        return call(args, std::index_sequence_for<Args...>());
+    }
+
+private:
+    template <size_t... I>
+    static Value call(const Value* args, std::index_sequence<I...>) {
+        (void)args;
+        if constexpr (std::is_void<R>::value) {
+            Fn(ValueConverter<typename std::decay<Args>::type>::fromValue(args[I])...);
+            return Value();
+        }
+        else {
+            return ValueConverter<typename std::decay<R>::type>::toValue(
+                Fn(ValueConverter<typename std::decay<Args>::type>::fromValue(args[I])...));
+        }
+    }
+};
+
+// Register the C++ function Fn as a global Luna function
+template <auto Fn>
+void bindFunction(Runtime& runtime, const std::string& name) {
+    static_assert(NativeBinding<Fn>::arity <= MAX_NATIVE_ARGS, "too many arguments for a native function");
+    runtime.getGlobals()->addFunction(new (runtime.getHeap()) Function(name, &NativeBinding<Fn>::invoke, NativeBinding<Fn>::arity));
+}
@@ -1,7 +1,212 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include "parser.cpp"
 
 
+// Result of processing one file in a batch
+struct BatchResult {
+	std::string output; // Text produced by the script
+	std::string error;  // Error message, empty on success
+	double readMs = 0;
+	double lexMs = 0;
+	double parseMs = 0;
+	double writeMs = 0;
+};
+
+// Non-interactive driver: luna run|check|compile [--jobs N] [--time] [--lazy] file...
+//
+// The parser builds no AST for the runtime yet, so every mode only parses.
+// run prints the parser's trace of each file (e.g. "Function call: f"),
+// check prints nothing but errors, and compile also writes a token cache.
+class BatchDriver {
+	public:
+	// Run the driver on command-line style arguments (without the program name)
+	int run(const std::vector<std::string>& args) {
+		if (args.empty()) {
+			usage();
+			return 2;
+		}
+
+		mode_ = args[0];
+		if (mode_ != "run" && mode_ != "check" && mode_ != "compile") {
+			usage();
+			return 2;
+		}
+
+		size_t jobs = std::thread::hardware_concurrency();
+		bool timing = false;
+		lazy_ = false;
+		std::vector<std::string> files;
+		for (size_t i = 1; i < args.size(); ++i) {
+			if (args[i] == "--jobs") {
+				if (i + 1 == args.size() || !parseJobs(args[++i], jobs)) {
+					usage();
+					return 2;
+				}
+			}
+			else if (args[i] == "--time") {
+				timing = true;
+			}
+			else if (args[i] == "--lazy") {
+				lazy_ = true;
+			}
+			else if (args[i].compare(0, 2, "--") == 0) {
+				// Unknown option, including "--jobs=N"
+				usage();
+				return 2;
+			}
+			else {
+				files.push_back(args[i]);
+			}
+		}
+		if (files.empty()) {
+			usage();
+			return 2;
+		}
+		if (jobs == 0) {
+			jobs = 1; // hardware_concurrency() may not know
+		}
+		if (jobs > files.size()) {
+			jobs = files.size();
+		}
+
+		// Files are independent, so workers pull the next index until all are done
+		auto start = std::chrono::steady_clock::now();
+		std::vector<BatchResult> results(files.size());
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			for (size_t i = next++; i < files.size(); i = next++) {
+				results[i] = processFile(files[i]);
+			}
+		};
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < jobs; ++i) {
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		double wallMs = millisecondsSince(start);
+
+		// Report in input order so output is deterministic
+		int failures = 0;
+		BatchResult total;
+		for (size_t i = 0; i < files.size(); ++i) {
+			std::cout << results[i].output;
+			if (!results[i].error.empty()) {
+				std::cerr << files[i] << ": " << results[i].error << std::endl;
+				++failures;
+			}
+			total.readMs += results[i].readMs;
+			total.lexMs += results[i].lexMs;
+			total.parseMs += results[i].parseMs;
+			total.writeMs += results[i].writeMs;
+		}
+
+		if (timing) {
+			std::cerr << files.size() << " files, " << jobs << " jobs, " << failures << " failed" << std::endl;
+			std::cerr << "  read:  " << total.readMs << " ms" << std::endl;
+			std::cerr << "  lex:   " << total.lexMs << " ms" << std::endl;
+			std::cerr << "  parse: " << total.parseMs << " ms" << std::endl;
+			std::cerr << "  write: " << total.writeMs << " ms" << std::endl;
+			std::cerr << "  wall:  " << wallMs << " ms" << std::endl;
+		}
+
+		return failures == 0 ? 0 : 1;
+	}
+
+	private:
+	// Read or load, parse and (for compile) cache a single file
+	BatchResult processFile(const std::string& path) {
+		BatchResult result;
+		try {
+			// Load a token cache directly, or read and tokenize source
+			auto start = std::chrono::steady_clock::now();
+			TokenBuffer tokens;
+			bool cached = path.size() > 6 && path.compare(path.size() - 6, 6, ".lunac") == 0;
+			if (cached) {
+				if (!tokens.load(path)) {
+					result.error = "Error: invalid token cache";
+					return result;
+				}
+				result.readMs = millisecondsSince(start);
+			}
+			else {
+				std::ifstream in(path, std::ios::binary);
+				if (!in) {
+					result.error = "Error: cannot open file";
+					return result;
+				}
+				std::stringstream buffer;
+				buffer << in.rdbuf();
+				std::string source = buffer.str();
+				result.readMs = millisecondsSince(start);
+
+				start = std::chrono::steady_clock::now();
+				tokens = Lexer(source).tokenize();
+				result.lexMs = millisecondsSince(start);
+			}
+
+			// Only run keeps the parser's trace output
+			start = std::chrono::steady_clock::now();
+			std::ostringstream output;
+			Parser parser(std::move(tokens), lazy_);
+			parser.setOutput(output);
+			parser.parse();
+			result.parseMs = millisecondsSince(start);
+			if (mode_ == "run") {
+				result.output = output.str();
+			}
+
+			if (mode_ == "compile" && !cached) {
+				start = std::chrono::steady_clock::now();
+				if (!parser.getTokens().save(path + "c")) {
+					result.error = "Error: cannot write " + path + "c";
+				}
+				result.writeMs = millisecondsSince(start);
+			}
+		}
+		catch (const std::exception& e) {
+			result.error = e.what();
+		}
+		return result;
+	}
+
+	// Parse a positive job count, rejecting anything that is not entirely digits
+	static bool parseJobs(const std::string& text, size_t& jobs) {
+		if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+			return false;
+		}
+		jobs = std::strtoul(text.c_str(), nullptr, 10);
+		return jobs > 0;
+	}
+
+	static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	static void usage() {
+		std::cerr << "Usage: luna run|check|compile [--jobs N] [--time] [--lazy] file..." << std::endl;
+		std::cerr << "  run      parse each file and print the parser's trace; scripts are not executed yet" << std::endl;
+		std::cerr << "  check    parse each file and report only errors" << std::endl;
+		std::cerr << "  compile  check, then write a token cache to <file>c" << std::endl;
+		std::cerr << "  --jobs   number of files parsed in parallel (a positive integer)" << std::endl;
+		std::cerr << "  --time   print per-phase timings" << std::endl;
+		std::cerr << "  --lazy   parse function bodies only when a call to them is parsed" << std::endl;
+	}
+
+	std::string mode_;
+	bool lazy_ = false;
+};
+
 // luna terminal
 class LunaTerminal {
 	public:
@@ -10,8 +215,7 @@ class LunaTerminal {
 		std::cout << "Luna Terminal - Type 'exit' to quit." << std::endl;
 		while (true) {
 			std::cout << "> ";
-			std::getline(std::cin, command);
-			if (command == "exit") {
+			if (!std::getline(std::cin, command) || command == "exit") {
 				break;
 			}
 			processCommand(command);
@@ -24,12 +228,27 @@ private:
 			std::cout << "Hello, Luna!" << std::endl;
 		}
 		else if (command == "help") {
-			std::cout << "Available commands: hello, help, exit" << std::endl;
-		} else if (command == "run") {
-
-
+			std::cout << "Available commands: hello, help, run|check|compile <files>, exit" << std::endl;
+		} else if (command == "run" || command.rfind("run ", 0) == 0 ||
+			command.rfind("check ", 0) == 0 || command.rfind("compile ", 0) == 0) {
+			// Split the command line and hand it to the batch driver
+			std::istringstream words(command);
+			std::vector<std::string> args;
+			for (std::string word; words >> word;) {
+				args.push_back(word);
+			}
+			BatchDriver().run(args);
 		} else {
 			std::cout << "Unknown command: " << command << std::endl;
 		}
 	}
 };
+
+int main(int argc, char* argv[]) {
+	// With arguments, run as a batch driver; otherwise start the terminal
+	if (argc > 1) {
+		return BatchDriver().run(std::vector<std::string>(argv + 1, argv + argc));
+	}
+	LunaTerminal().run();
+	return 0;
+}
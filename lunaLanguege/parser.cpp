@@ -3,374 +3,559 @@
 #include <iostream>
 #include <vector>
 #include <filesystem>
-#include <stack> // Add this for std::stack
+#include <map>
+#include <set>
 #include "lexer.cpp"
 
-// TokenType extension for custom statements
-enum ExtendedTokenType {
-    TOKEN_IMPORT = 1000, // Use a value outside the base enum to avoid collision
-    TOKEN_STRING
+// Pre-parsed function whose body is only compiled on its first call
+struct FunctionStub {
+    size_t tokenStart; // Index of the first body token
+    size_t tokenCount; // Number of tokens in the body
+    bool compiled;     // Whether the body has been fully parsed
 };
 
 // Parser class
+//
+// The whole input is tokenized up front into a TokenBuffer, and the parser
+// walks it by index. Each statement method starts at its first token and
+// leaves pos_ just past its last one.
 class Parser {
 public:
-    Parser(const std::string& sourceCode) : lexer_(sourceCode), loopExit_(false), loop_(0) {} // initialize new members
+    // When lazyFunctions is set, function bodies are only "end" matched at
+    // declaration time and fully parsed at the first call the parser reaches.
+    // The parser builds no AST for the runtime, so a "call" is a call statement
+    // in the source text, whether or not it would run.
+    Parser(const std::string& sourceCode, bool lazyFunctions = false)
+        : Parser(Lexer(sourceCode).tokenize(), lazyFunctions) {}
+
+    // Parse an already tokenized input, e.g. one loaded from a token cache
+    Parser(TokenBuffer tokens, bool lazyFunctions = false)
+        : tokens_(std::move(tokens)), pos_(0), out_(&std::cout), loopDepth_(0), functionDepth_(0), lazyFunctions_(lazyFunctions) {}
+
+    // Redirect text produced while parsing (defaults to std::cout)
+    void setOutput(std::ostream& out) {
+        out_ = &out;
+    }
+
+    // Get the token buffer being parsed
+    const TokenBuffer& getTokens() const {
+        return tokens_;
+    }
 
     // Parse the source code and generate an abstract syntax tree (AST)
     void parse() {
-        // Get the first token from the lexer
-        Token token = lexer_.getNextToken();
-
-        // Start parsing the program
-        program(token);
+        pos_ = 0;
+        program();
     }
 
     // Program -> Statement*
-    void program(Token token) {
-        while (token.type != TOKEN_EOF) {
-            statement(token);
-            token = lexer_.getNextToken();
+    void program() {
+        while (peekType() != TOKEN_EOF) {
+            statement();
         }
     }
 
     // Statement -> IfStatement | WhileStatement | FunctionDeclaration | ExpressionStatement
-    void statement(Token token) {
-        if (token.type == TOKEN_KEYWORD && token.value == "if") {
-            ifStatement(token);
+    void statement() {
+        if (isKeyword(KW_IF)) {
+            ifStatement();
         }
-        else if (token.type == TOKEN_KEYWORD && token.value == "while") {
-            whileStatement(token);
+        else if (isKeyword(KW_WHILE)) {
+            whileStatement();
         }
-        else if (token.type == TOKEN_KEYWORD && token.value == "func") {
-            functionDeclaration(token);
+        else if (isKeyword(KW_FUNC)) {
+            functionDeclaration();
         }
-        else if (token.type == TOKEN_KEYWORD && token.value == "import") {
-            importStatement(token);
+        else if (peekType() == TOKEN_IMPORT) {
+            importStatement();
         }
-        else if (token.type == TOKEN_KEYWORD && (token.value == "true" || token.value == "false")) {
-            boolStatement(token);
+        else if (isKeyword(KW_TRUE) || isKeyword(KW_FALSE)) {
+            boolStatement();
         }
-        else if (token.type == TOKEN_KEYWORD && token.value == "export") {
-            exportStatement(token);
+        else if (isKeyword(KW_EXPORT)) {
+            exportStatement();
         }
-        else if (token.type == TOKEN_KEYWORD && token.value == "let") {
-            letStatement(token);
-
+        else if (isKeyword(KW_LET)) {
+            letStatement();
+        }
+        else if (isKeyword(KW_VAR)) {
+            varStatement();
         }
-        else if (token.type == TOKEN_KEYWORD && token.value == "var") {
-            varStatement(token);
+        else if (isKeyword(KW_BREAK)) {
+            breakStatement();
         }
-        else if (token.type == TOKEN_KEYWORD && token.value == "break") {
-            breakStatement(token);
+        else if (isKeyword(KW_CONTINUE)) {
+            continueStatement();
         }
-        else if (token.type == TOKEN_KEYWORD && token.value == "loop") {
-            loopStatement(token);
+        else if (isKeyword(KW_LOOP)) {
+            loopStatement();
         }
-        else if (token.type == TOKEN_KEYWORD && token.value == "print") {
-            printstament(token);
+        else if (isKeyword(KW_RETURN)) {
+            returnStatement();
         }
-        else if (token.type == TOKEN_STRING) {
-            stringStatement(token);
+        else if (isKeyword(KW_PRINT)) {
+            printstament();
         }
-        else if (token.type == TOKEN_NUMBER) {
-            numberStatement(token);
+        else if (peekType() == TOKEN_STRING) {
+            stringStatement();
         }
-        else if (token.type == TOKEN_IDENTIFIER) {
-            callStatement(token); // Handle function calls or variable access
+        else if (peekType() == TOKEN_NUMBER) {
+            numberStatement();
+        }
+        else if (peekType() == TOKEN_IDENTIFIER) {
+            callStatement(); // Handle function calls or variable access
         }
         else {
-            expressionStatement(token);
+            expressionStatement();
         }
     }
 
 	// letStatement -> "let" IDENTIFIER "=" Expression ";"
-	void letStatement(Token token) {
+	void letStatement() {
 		// Consume the "let" keyword
-		token = lexer_.getNextToken();
+		advance();
 
 		// Check for identifier
-		if (token.type != TOKEN_IDENTIFIER) {
+		if (peekType() != TOKEN_IDENTIFIER) {
 			error("Expected identifier");
 		}
-
-		// Get the identifier name
-		std::string identifier = token.value;
+		advance();
 
 		// Consume the "=" operator
-		token = lexer_.getNextToken();
+		expectSymbol("=", "Expected '=' after identifier");
 
 		// Parse the expression
-		expression(token);
+		expression();
 
 		// Consume the ";" terminator
-		token = lexer_.getNextToken();
-
-		// Check for syntax error
-		if (token.type != TOKEN_SYMBOL || token.value != ";") {
-			error("Expected ';' terminator");
-		}
+		expectSymbol(";", "Expected ';' terminator");
 	}
 
     // IfStatement -> "if" Expression "then" Statement "end"
-    void ifStatement(Token token) {
+    void ifStatement() {
         // Consume the "if" keyword
-        token = lexer_.getNextToken();
+        advance();
 
         // Parse the condition expression
-        expression(token);
+        expression();
 
         // Consume the "then" keyword
-        token = lexer_.getNextToken();
+        expectWord("then", "Expected 'then' after if condition");
 
         // Parse the then statement
-        statement(token);
+        statement();
 
         // Consume the "end" keyword
-        token = lexer_.getNextToken();
-
-        // Check for syntax error
-        if (token.type != TOKEN_KEYWORD || token.value != "end") {
-            error("Expected 'end' keyword");
-        }
+        expectKeyword(KW_END, "Expected 'end' keyword");
     }
 
     // WhileStatement -> "while" Expression "do" Statement "end"
-    void whileStatement(Token token) {
+    void whileStatement() {
         // Consume the "while" keyword
-        token = lexer_.getNextToken();
+        advance();
 
         // Parse the condition expression
-        expression(token);
+        expression();
 
         // Consume the "do" keyword
-        token = lexer_.getNextToken();
+        expectWord("do", "Expected 'do' after while condition");
 
         // Parse the loop body statement
-        statement(token);
+        ++loopDepth_;
+        statement();
+        --loopDepth_;
 
         // Consume the "end" keyword
-        token = lexer_.getNextToken();
-
-        // Check for syntax error
-        if (token.type != TOKEN_KEYWORD || token.value != "end") {
-            error("Expected 'end' keyword after while statement");
-        }
+        expectKeyword(KW_END, "Expected 'end' keyword after while statement");
     }
 
     // FunctionDeclaration -> "func" IDENTIFIER Statement "end"
-    void functionDeclaration(Token token) {
+    void functionDeclaration() {
         // Consume the "func" keyword
-        token = lexer_.getNextToken();
+        advance();
 
         // Parse function name (identifier)
-        if (token.type != TOKEN_IDENTIFIER) {
+        if (peekType() != TOKEN_IDENTIFIER) {
             error("Expected function name after 'func'");
         }
-        token = lexer_.getNextToken();
+        uint32_t name = peekSymbol();
+        advance();
+
+        // Defer the body until the function is first called
+        if (lazyFunctions_) {
+            preParseFunctionBody(name);
+            return;
+        }
 
         // Optionally parse parameters, etc. (not implemented)
 
         // Parse function body
-        statement(token);
+        int outerLoopDepth = loopDepth_;
+        loopDepth_ = 0;
+        ++functionDepth_;
+        statement();
+        --functionDepth_;
+        loopDepth_ = outerLoopDepth;
 
         // Consume the "end" keyword
-        token = lexer_.getNextToken();
+        expectKeyword(KW_END, "Expected 'end' keyword after function declaration");
+    }
 
-        if (token.type != TOKEN_KEYWORD || token.value != "end") {
-            error("Expected 'end' keyword after function declaration");
+    // Skip a function body by matching nested "end" keywords, recording its span
+    void preParseFunctionBody(uint32_t name) {
+        FunctionStub stub;
+        stub.tokenStart = pos_;
+        stub.compiled = false;
+
+        int depth = 1;
+        for (; ; advance()) {
+            if (peekType() == TOKEN_EOF) {
+                error("Expected 'end' keyword after function declaration");
+            }
+            if (isKeyword(KW_IF) || isKeyword(KW_WHILE) || isKeyword(KW_FUNC) || isKeyword(KW_LOOP)) {
+                ++depth;
+            }
+            else if (isKeyword(KW_END) && --depth == 0) {
+                break;
+            }
+        }
+
+        stub.tokenCount = pos_ - stub.tokenStart;
+        advance();
+
+        // A function called before its declaration is compiled straight away
+        FunctionStub& declared = functions_[name] = stub;
+        if (calledNames_.count(name) != 0) {
+            compileFunction(declared);
         }
     }
 
+    // Fully parse a pre-parsed function body in place in the token buffer
+    void compileFunction(FunctionStub& stub) {
+        // Mark first so a recursive call does not compile the body again
+        stub.compiled = true;
+
+        size_t resumePos = pos_;
+        int outerLoopDepth = loopDepth_;
+        pos_ = stub.tokenStart;
+        loopDepth_ = 0;
+
+        // FunctionBody -> Statement "end"
+        ++functionDepth_;
+        statement();
+        --functionDepth_;
+        if (pos_ != stub.tokenStart + stub.tokenCount) {
+            error("Expected 'end' keyword after function declaration");
+        }
+
+        pos_ = resumePos;
+        loopDepth_ = outerLoopDepth;
+    }
 
 	// PrintStatement -> "print" Expression = () IDENTIFIER ";"
-    void printstament(Token token) {
+    void printstament() {
         // Consume the "print" keyword
-        token = lexer_.getNextToken();
+        advance();
         // Expect an identifier or literal for printing
-        if (token.type != TOKEN_IDENTIFIER && token.type != TOKEN_LITERAL) {
+        if (peekType() != TOKEN_IDENTIFIER && peekType() != TOKEN_LITERAL) {
             error("Expected identifier or literal after 'print'");
         }
         // Print the value
-        std::cout << token.value << std::endl;
+        *out_ << peekText() << std::endl;
+        advance();
         // Consume the ";" terminator
-        token = lexer_.getNextToken();
-        if (token.type != TOKEN_SYMBOL || token.value != ";") {
-            error("Expected ';' terminator after print statement");
-		}
-		
-        
-
+        expectSymbol(";", "Expected ';' terminator after print statement");
     }
 
     // ImportStatement -> "import" IDENTIFIER
-    void importStatement(Token token) {
+    void importStatement() {
         // Consume the "import" keyword
-        token = lexer_.getNextToken();
+        advance();
         // Expect an identifier for the module name
-        if (token.type != TOKEN_IDENTIFIER) {
+        if (peekType() != TOKEN_IDENTIFIER) {
             error("Expected module name after 'import'");
         }
         // Construct the directory path
-        std::string dir = "lina_modules/" + token.value;
+        std::string dir = "lina_modules/" + peekText();
 
         // Check if the directory exists
         if (std::filesystem::exists(dir)) {
-            std::cout << "Module found: " << token.value << std::endl;
+            *out_ << "Module found: " << peekText() << std::endl;
         } else {
             error("Module not found");
         }
+        advance();
     }
 
 	// VarStatement -> "var" IDENTIFIER "=" Expression ";"
-	void varStatement(Token token) {
+	void varStatement() {
 		// Consume the "var" keyword
-		token = lexer_.getNextToken();
+		advance();
         // Expect an identifier for the variable name
-        if (token.type != TOKEN_IDENTIFIER) {
+        if (peekType() != TOKEN_IDENTIFIER) {
             error("Expected variable name after 'var'");
         }
-        // Get the variable name
-        std::string varName = token.value;
+        advance();
         // Consume the "=" operator
-        token = lexer_.getNextToken();
+        expectSymbol("=", "Expected '=' after variable name");
         // Parse the expression
-        expression(token);
+        expression();
         // Consume the ";" terminator
-        token = lexer_.getNextToken();
-        // Check for syntax error
-        if (token.type != TOKEN_SYMBOL || token.value != ";") {
-            error("Expected ';' terminator after variable declaration");
-        }
+        expectSymbol(";", "Expected ';' terminator after variable declaration");
 	}
 
     // ExpressionStatement -> Expression
-    void expressionStatement(Token token) {
+    void expressionStatement() {
         // Parse the expression
-        expression(token);
+        expression();
     }
 
     // BoolStatement -> "true" | "false"
-    void boolStatement(Token token) {
-        if (token.type == TOKEN_KEYWORD && token.value == "true") {
+    void boolStatement() {
+        if (isKeyword(KW_TRUE)) {
             // set stuff to true
 
         }
-        else if (token.type == TOKEN_KEYWORD && token.value == "false") {
+        else if (isKeyword(KW_FALSE)) {
 			// set stuff to false
-            
+
         }
         else {
             error("Expected 'true' or 'false' keyword");
         }
+        advance();
     }
 
-    // Handle a break statement
-    void breakStatement(Token token) {
-        // Check if the token is a break keyword
-        if (token.type == TOKEN_KEYWORD && token.value == "break") {
-            // Exit the loop
-            loopStack_.pop();
-            // Set the loop exit flag
-            loopExit_ = true;
-        }
-        else {
-            // Error: expected break keyword
+    // BreakStatement -> "break"
+    void breakStatement() {
+        if (!isKeyword(KW_BREAK)) {
             error("Expected 'break' keyword");
         }
+        if (loopDepth_ == 0) {
+            error("'break' outside of a loop");
+        }
+        advance();
     }
-    // Handle a loop statement
-    void loopStatement(Token token) {
-        // Check if the token is a loop keyword
-        if (token.type == TOKEN_KEYWORD && token.value == "loop") {
-            // Push the loop onto the loop stack
-            loopStack_.push(loop_);
-            // Set the loop exit flag to false
-            loopExit_ = false;
-            // Execute the loop body
-            while (!loopExit_) {
-                // Execute the loop body
-                statement(token);
-            }
-            // Pop the loop from the loop stack
-            loopStack_.pop();
+
+    // ContinueStatement -> "continue"
+    void continueStatement() {
+        if (!isKeyword(KW_CONTINUE)) {
+            error("Expected 'continue' keyword");
         }
-        else {
-            // Error: expected loop keyword
+        if (loopDepth_ == 0) {
+            error("'continue' outside of a loop");
+        }
+        advance();
+    }
+
+    // LoopStatement -> "loop" Statement* "end"
+    // The body is parsed once; iteration is left to the runtime
+    void loopStatement() {
+        if (!isKeyword(KW_LOOP)) {
             error("Expected 'loop' keyword");
         }
+        advance();
+
+        // Parse body statements up to the matching "end"
+        ++loopDepth_;
+        while (!isKeyword(KW_END)) {
+            if (peekType() == TOKEN_EOF) {
+                error("Expected 'end' keyword after loop statement");
+            }
+            statement();
+        }
+        --loopDepth_;
+        advance();
+    }
+
+    // ReturnStatement -> "return" [ CallStatement | Expression ] [ ";" ]
+    // "return f(...)" is a tail call and runs in the caller's frame
+    void returnStatement() {
+        if (functionDepth_ == 0) {
+            error("'return' outside of a function");
+        }
+        advance();
+
+        if (peekType() == TOKEN_IDENTIFIER && peekType(1) == TOKEN_SYMBOL && peekText(1) == "(") {
+            callStatement();
+            return;
+        }
+        if (!isSymbol(";") && !isKeyword(KW_END)) {
+            expression();
+        }
+        if (isSymbol(";")) {
+            advance();
+        }
     }
 
-    // exportStatement -> "export" IDENTIFIER
-    void exportStatement(Token token) {
+    // exportStatement -> "export" IDENTIFIER ";"
+    void exportStatement() {
         // Consume the "export" keyword
-        token = lexer_.getNextToken();
+        advance();
 
 		// Expect an identifier for the variable name
-		if (token.type != TOKEN_IDENTIFIER) {
+		if (peekType() != TOKEN_IDENTIFIER) {
 			error("Expected variable name after 'export'");
 		}
 
-		// Get the variable name
-		std::string varName = token.value;
-
-		std::cout << "Exporting variable: " << varName << std::endl;
+		*out_ << "Exporting variable: " << peekText() << std::endl;
 
 		// Consume the token
-		token = lexer_.getNextToken();
+		advance();
 
 		// Check for syntax error (optional, depending on your language design)
-		if (token.type != TOKEN_SYMBOL || token.value != ";") {
-			error("Expected ';' terminator");
-		}
-
+		expectSymbol(";", "Expected ';' terminator");
     }
-    // CallStatement -> IDENTIFIER (arguments not implemented)
-    void callStatement(Token token) {
-        if (token.type == TOKEN_IDENTIFIER) {
-            std::cout << "Function call: " << token.value << std::endl;
-            // Consume the identifier token
-            token = lexer_.getNextToken();
-            // Optionally handle arguments (not implemented)
-        }
-        else {
+
+    // CallStatement -> IDENTIFIER [ "(" [ Expression { "," Expression } ] ")" ] [ ";" ]
+    void callStatement() {
+        if (peekType() != TOKEN_IDENTIFIER) {
             error("Expected function name for call statement");
         }
+        *out_ << "Function call: " << peekText() << std::endl;
+
+        // Compile a lazily declared function on its first call
+        if (lazyFunctions_) {
+            calledNames_.insert(peekSymbol());
+            auto it = functions_.find(peekSymbol());
+            if (it != functions_.end() && !it->second.compiled) {
+                compileFunction(it->second);
+            }
+        }
+
+        // Consume the identifier token
+        advance();
+
+        // Optional argument list
+        if (isSymbol("(")) {
+            advance();
+            if (!isSymbol(")")) {
+                expression();
+                while (isSymbol(",")) {
+                    advance();
+                    expression();
+                }
+            }
+            expectSymbol(")", "Expected ')' after call arguments");
+        }
+
+        // Optional terminator
+        if (isSymbol(";")) {
+            advance();
+        }
     }
 
     // Handle a string literal statement
-    void stringStatement(Token token) {
+    void stringStatement() {
         // For demonstration, just print the string literal
-        std::cout << "String literal: \"" << token.value << "\"" << std::endl;
+        *out_ << "String literal: \"" << peekText() << "\"" << std::endl;
+        advance();
     }
 
     // Handle a number literal statement
-    void numberStatement(Token token) {
+    void numberStatement() {
         // For demonstration, just print the number literal
-        std::cout << "Number literal: " << token.value << std::endl;
+        *out_ << "Number literal: " << peekText() << std::endl;
+        advance();
     }
 
     // Expression -> LITERAL | IDENTIFIER | NUMBER | STRING
-    void expression(Token token) {
-        if (token.type != TOKEN_LITERAL &&
-            token.type != TOKEN_IDENTIFIER &&
-            token.type != TOKEN_NUMBER &&
-            token.type != TOKEN_STRING) {
+    void expression() {
+        TokenType type = peekType();
+        if (type != TOKEN_LITERAL &&
+            type != TOKEN_IDENTIFIER &&
+            type != TOKEN_NUMBER &&
+            type != TOKEN_STRING) {
             error("Expected expression");
         }
+        advance();
     }
 
     // Error handling function
-    void error(const std::string& message) {
-        std::cerr << "Error: " << message << std::endl;
-        exit(1);
+    [[noreturn]] void error(const std::string& message) {
+        throw std::runtime_error("Error: " + message);
+    }
+
+private:
+    // Index of the token n positions ahead, clamped to the trailing EOF
+    size_t peekIndex(size_t n) const {
+        size_t index = pos_ + n;
+        return index < tokens_.size() ? index : tokens_.size() - 1;
+    }
+
+    // Type of the token n positions ahead
+    TokenType peekType(size_t n = 0) const {
+        return tokens_.types[peekIndex(n)];
+    }
+
+    // Symbol ID of the token n positions ahead
+    uint32_t peekSymbol(size_t n = 0) const {
+        return tokens_.symbols[peekIndex(n)];
+    }
+
+    // Text of the token n positions ahead
+    const std::string& peekText(size_t n = 0) const {
+        return tokens_.text(peekIndex(n));
+    }
+
+    // Move to the next token, stopping at EOF
+    void advance() {
+        if (pos_ + 1 < tokens_.size()) {
+            ++pos_;
+        }
+    }
+
+    // Check the current token against a keyword
+    bool isKeyword(KeywordId keyword) const {
+        return peekType() == TOKEN_KEYWORD && peekSymbol() == static_cast<uint32_t>(keyword);
+    }
+
+    // Check the current token against a symbol
+    bool isSymbol(const char* symbol) const {
+        return peekType() == TOKEN_SYMBOL && peekText() == symbol;
+    }
+
+    // Consume a required keyword
+    void expectKeyword(KeywordId keyword, const char* message) {
+        if (!isKeyword(keyword)) {
+            error(message);
+        }
+        advance();
+    }
+
+    // Consume a required symbol
+    void expectSymbol(const char* symbol, const char* message) {
+        if (!isSymbol(symbol)) {
+            error(message);
+        }
+        advance();
+    }
+
+    // Consume a required contextual word such as "then" or "do"
+    void expectWord(const char* word, const char* message) {
+        if (peekType() != TOKEN_IDENTIFIER || peekText() != word) {
+            error(message);
+        }
+        advance();
     }
 
-    // Lexer instance
-    Lexer lexer_;
+    // Tokens being parsed and the current position in them
+    TokenBuffer tokens_;
+    size_t pos_;
+
+    // Destination for text produced while parsing
+    std::ostream* out_;
+
+    // Number of enclosing loops, for validating break/continue
+    int loopDepth_;
 
-    // Add missing members for loop handling
-    std::stack<int> loopStack_; // or use appropriate type if needed
-    bool loopExit_;
-    int loop_; // Placeholder type, adjust as needed
-};
\ No newline at end of file
+    // Number of enclosing function bodies, for validating return
+    int functionDepth_;
+
+    // Lazily declared functions, keyed by name symbol
+    bool lazyFunctions_;
+    std::map<uint32_t, FunctionStub> functions_;
+
+    // Names seen in call statements, so a later declaration is compiled at once
+    std::set<uint32_t> calledNames_;
+};
@@ -1,9 +1,17 @@
 // runtime.cpp
 
 #include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
 #include <map>
+#include <memory>
 #include <vector>
                             #include <string>
+#include "allocator.cpp"
 
 // Minimal AST node and enums to resolve missing identifiers
 enum AstNodeType {
@@ -13,7 +21,20 @@ enum AstNodeType {
     AST_NODE_EXPRESSION_STATEMENT,
     AST_NODE_LITERAL,
     AST_NODE_IDENTIFIER,
-    AST_NODE_FUNCTION_CALL
+    AST_NODE_FUNCTION_CALL,
+    AST_NODE_LOOP_STATEMENT,
+    AST_NODE_BREAK_STATEMENT,
+    AST_NODE_CONTINUE_STATEMENT,
+    AST_NODE_RETURN_STATEMENT
+};
+
+// Pending non-local control flow while running statements
+enum ControlSignal {
+    CONTROL_NONE,
+    CONTROL_BREAK,
+    CONTROL_CONTINUE,
+    CONTROL_RETURN,
+    CONTROL_TAIL_CALL
 };
 
 struct AstNode {
@@ -23,6 +44,60 @@ struct AstNode {
     AstNode* right;
 };
 
+// Resource limits for a runtime; zero means unlimited. Tail calls run in
+// constant space, but every other Luna call recurses on the native stack at
+// roughly 1 KB per call, so hosts running untrusted scripts should set
+// maxCallDepth to fit their thread's stack (about 512 for 1 MB).
+struct ExecutionLimits {
+    uint64_t maxInstructions; // Fuel, charged once per loop iteration and call
+    uint64_t maxMilliseconds; // Wall-clock budget for each run
+    size_t maxHeapBytes;      // Bytes allocated from the runtime's heap (see getAllocationStats)
+    size_t maxCallDepth;      // Nested non-tail function calls
+};
+
+// Resource usage of the current or last run. The heap figures are read from
+// the runtime's SlabAllocator, which holds the global scope and every function;
+// call scopes live on the C++ stack and variable storage on the global heap.
+struct ExecutionStats {
+    uint64_t instructions;
+    uint64_t elapsedMilliseconds;
+    size_t heapBytes;         // AllocationStats::bytes at the last sample
+    size_t heapAllocations;   // Allocations from the runtime's heap during the run
+    size_t peakHeapBytes;     // Highest heapBytes sampled during the run
+    size_t callDepth;
+    size_t peakCallDepth;
+};
+
+// Which limit stopped a script
+enum LimitKind {
+    LIMIT_INSTRUCTIONS,
+    LIMIT_DEADLINE,
+    LIMIT_HEAP,
+    LIMIT_CALL_DEPTH,
+    LIMIT_INTERRUPT
+};
+
+// Thrown out of Runtime::run when a script exceeds its limits
+class ExecutionLimitError : public std::runtime_error {
+public:
+    ExecutionLimitError(LimitKind kind, const std::string& message, const ExecutionStats& stats)
+        : std::runtime_error(message), kind_(kind), stats_(stats) {}
+
+    // Get the limit that was exceeded
+    LimitKind getKind() const {
+        return kind_;
+    }
+
+    // Get the resource usage at the point of termination
+    const ExecutionStats& getStats() const {
+        return stats_;
+    }
+
+private:
+    LimitKind kind_;
+    ExecutionStats stats_;
+};
+
 // Forward declarations
 class Value;
 class Function;
@@ -34,10 +109,10 @@ public:
     // Default constructor
     Value() : value_("") {}
     // Constructor
-    Value(const std::string& value) : value_(value) {}
+    Value(std::string value) : value_(std::move(value)) {}
 
     // Get the value
-    std::string getValue() const {
+    const std::string& getValue() const {
         return value_;
     }
 
@@ -50,11 +125,20 @@ private:
     std::string value_;
 };
 
+// Maximum number of arguments a native function can take
+const size_t MAX_NATIVE_ARGS = 8;
+
+// Entry point of a native function; args holds exactly the function's arity values
+typedef Value (*NativeThunk)(const Value* args);
+
 // Function class
-class Function {
+class Function : public SlabAllocated<ALLOC_FUNCTION> {
 public:
     // Constructor
-    Function(const std::string& name, AstNode* body) : name_(name), body_(body) {}
+    Function(const std::string& name, AstNode* body) : name_(name), body_(body), native_(nullptr), arity_(0) {}
+
+    // Constructor for a function implemented by the host
+    Function(const std::string& name, NativeThunk native, size_t arity) : name_(name), body_(nullptr), native_(native), arity_(arity) {}
 
     // Get the function name
     std::string getName() const {
@@ -66,23 +150,55 @@ public:
         return body_;
     }
 
+    // Check whether the function is implemented by the host
+    bool isNative() const {
+        return native_ != nullptr;
+    }
+
+    // Get the native entry point
+    NativeThunk getNative() const {
+        return native_;
+    }
+
+    // Get the number of arguments a native function takes
+    size_t getArity() const {
+        return arity_;
+    }
+
 private:
     std::string name_;
     AstNode* body_;
+    NativeThunk native_;
+    size_t arity_;
 };
 
 // Scope class
-class Scope {
+class Scope : public SlabAllocated<ALLOC_SCOPE> {
 public:
     // Constructor
     Scope() : lastValue_() {}
 
-    // Destructor
-    ~Scope() {}
+    // Destructor; the scope owns the functions declared in it
+    ~Scope() {
+        clear();
+    }
+
+    // Remove all variables and functions so the scope can be reused by another call
+    void clear() {
+        for (auto& function : functions_) {
+            delete function.second;
+        }
+        functions_.clear();
+        variables_.clear();
+        lastValue_ = Value();
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
 
     // Add a variable to the scope
     void addVariable(const std::string& name, Value value) {
-        variables_[name] = value;
+        variables_[name] = std::move(value);
     }
 
     // Get a variable from the scope
@@ -99,7 +215,28 @@ public:
 
     // Add a function to the scope
     void addFunction(Function* function) {
-        functions_[function->getName()] = function;
+        Function*& slot = functions_[function->getName()];
+        if (slot != function) {
+            delete slot;
+        }
+        slot = function;
+    }
+
+    // Remove a function declared in this scope without freeing it; returns
+    // nullptr if the function belongs to another scope
+    Function* takeFunction(Function* function) {
+        auto it = functions_.find(function->getName());
+        if (it == functions_.end() || it->second != function) {
+            return nullptr;
+        }
+        functions_.erase(it);
+        return function;
+    }
+
+    // Find a function in the scope, or nullptr if it is not declared here
+    Function* findFunction(const std::string& name) {
+        auto it = functions_.find(name);
+        return it != functions_.end() ? it->second : nullptr;
     }
 
     // Get a function from the scope
@@ -114,6 +251,16 @@ public:
         }
     }
 
+    // Get all variables in the scope
+    const std::map<std::string, Value>& getVariables() const {
+        return variables_;
+    }
+
+    // Get all functions in the scope
+    const std::map<std::string, Function*>& getFunctions() const {
+        return functions_;
+    }
+
     // Get the last value in the scope
     Value getLastValue() {
         return lastValue_;
@@ -134,27 +281,180 @@ private:
 class Runtime {
 public:
     // Constructor
-    Runtime() {}
+    Runtime() : globals_(new (heap_) Scope()), control_(CONTROL_NONE), tailFunction_(nullptr), tailArgsStart_(0), limits_(), stats_(), runStartAllocations_(0), nextCheck_(0), interruptRequested_(false) {}
 
     // Destructor
-    ~Runtime() {}
+    ~Runtime() {
+        delete globals_;
+    }
 
-    // Run the program
+    // Run the program in the global scope, which persists between runs.
+    // Throws ExecutionLimitError if the program exceeds the runtime's limits.
     void run(AstNode* program) {
-        // Create a scope for the program
-        Scope* scope = new Scope();
+        startRun();
+        try {
+            runProgram(program, globals_);
+        }
+        catch (...) {
+            // Unwinding freed every call frame; only global functions remain
+            control_ = CONTROL_NONE;
+            tailArgs_.clear();
+            sampleHeap();
+            stats_.callDepth = 0;
+            throw;
+        }
+        sampleHeap();
+        stats_.elapsedMilliseconds = elapsedMilliseconds();
+    }
+
+    // Set the resource limits applied to subsequent runs
+    void setLimits(const ExecutionLimits& limits) {
+        limits_ = limits;
+    }
+
+    // Get the resource usage of the current or last run
+    const ExecutionStats& getStats() const {
+        return stats_;
+    }
+
+    // Ask a running script to stop at its next safepoint; safe to call from any thread.
+    // Only the current run is affected: a request made while no run is active is
+    // discarded when the next run starts.
+    void requestInterrupt() {
+        interruptRequested_.store(true, std::memory_order_relaxed);
+    }
+
+    // Get the allocator used for this runtime's scopes and functions
+    SlabAllocator& getHeap() {
+        return heap_;
+    }
+
+    // Get bytes, per-kind object counts and the high-water mark of the runtime's allocator.
+    // maxHeapBytes is enforced against the same bytes; peakBytes spans every run since the last reset.
+    AllocationStats getAllocationStats() const {
+        return heap_.getStats();
+    }
 
-        // Run the program
-        runProgram(program, scope);
+    // Discard all global state and return the runtime's slabs in bulk,
+    // e.g. once a script has finished and the runtime is reused for another
+    void reset() {
+        delete globals_;
+        snapshotNodes_.clear();
+        heap_.reset();
+        globals_ = new (heap_) Scope();
+        stats_ = ExecutionStats();
+        runStartAllocations_ = 0;
+    }
+
+    // Get the global scope
+    Scope* getGlobals() {
+        return globals_;
+    }
+
+    // Save the global variables and functions to a snapshot file
+    bool saveSnapshot(const std::string& path) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            std::cerr << "Error: cannot write snapshot " << path << std::endl;
+            return false;
+        }
+
+        out.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        writeInt(out, SNAPSHOT_VERSION);
+
+        // Variables
+        const std::map<std::string, Value>& variables = globals_->getVariables();
+        writeInt(out, static_cast<uint32_t>(variables.size()));
+        for (const auto& variable : variables) {
+            writeString(out, variable.first);
+            writeString(out, variable.second.getValue());
+        }
+
+        // Functions, with their bodies; native functions are rebound by the host
+        const std::map<std::string, Function*>& functions = globals_->getFunctions();
+        uint32_t scriptFunctions = 0;
+        for (const auto& function : functions) {
+            scriptFunctions += function.second->isNative() ? 0 : 1;
+        }
+        writeInt(out, scriptFunctions);
+        for (const auto& function : functions) {
+            if (function.second->isNative()) {
+                continue;
+            }
+            writeString(out, function.first);
+            writeNode(out, function.second->getBody());
+        }
 
-        // Delete the scope
-        delete scope;
+        writeString(out, globals_->getLastValue().getValue());
+        return static_cast<bool>(out);
+    }
+
+    // Replace the global scope with the contents of a snapshot file
+    bool loadSnapshot(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[sizeof(SNAPSHOT_MAGIC)];
+        if (!in.read(magic, sizeof(magic)) ||
+            std::string(magic, sizeof(magic)) != std::string(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) ||
+            readInt(in) != SNAPSHOT_VERSION) {
+            std::cerr << "Error: invalid snapshot " << path << std::endl;
+            return false;
+        }
+
+        Scope* scope = new (heap_) Scope();
+        std::vector<std::unique_ptr<AstNode>> nodes;
+
+        // Variables
+        uint32_t variableCount = readInt(in);
+        for (uint32_t i = 0; i < variableCount && in; ++i) {
+            std::string name = readString(in);
+            scope->addVariable(name, Value(readString(in)));
+        }
+
+        // Functions, with their bodies
+        uint32_t functionCount = readInt(in);
+        for (uint32_t i = 0; i < functionCount && in; ++i) {
+            std::string name = readString(in);
+            AstNode* body = readNode(in, nodes, 0);
+            if (body == nullptr) {
+                in.setstate(std::ios::failbit);
+                break;
+            }
+            scope->addFunction(new (heap_) Function(name, body));
+        }
+
+        scope->setLastValue(Value(readString(in)));
+
+        // Reject nodes missing children the runtime dereferences
+        for (const auto& node : nodes) {
+            if (!hasValidShape(node.get())) {
+                in.setstate(std::ios::failbit);
+                break;
+            }
+        }
+
+        if (!in) {
+            std::cerr << "Error: truncated or corrupt snapshot " << path << std::endl;
+            delete scope;
+            return false;
+        }
+
+        // The restored function bodies replace those of any earlier snapshot
+        delete globals_;
+        globals_ = scope;
+        snapshotNodes_ = std::move(nodes);
+        stats_.heapBytes = heap_.getStats().bytes;
+        return true;
     }
 
     // Run a program
     void runProgram(AstNode* program, Scope* scope) {
-        // Run each statement in the program
-        for (AstNode* statement = program->left; statement != nullptr; statement = statement->right) {
+        runBlock(program, scope);
+        control_ = CONTROL_NONE;
+    }
+
+    // Run each statement in a block, stopping early on break or continue
+    void runBlock(AstNode* block, Scope* scope) {
+        for (AstNode* statement = block->left; statement != nullptr && control_ == CONTROL_NONE; statement = statement->right) {
             runStatement(statement, scope);
         }
     }
@@ -175,6 +475,18 @@ public:
         case AST_NODE_EXPRESSION_STATEMENT:
             runExpressionStatement(statement, scope);
             break;
+        case AST_NODE_LOOP_STATEMENT:
+            runLoopStatement(statement, scope);
+            break;
+        case AST_NODE_BREAK_STATEMENT:
+            control_ = CONTROL_BREAK;
+            break;
+        case AST_NODE_CONTINUE_STATEMENT:
+            control_ = CONTROL_CONTINUE;
+            break;
+        case AST_NODE_RETURN_STATEMENT:
+            runReturnStatement(statement, scope);
+            break;
         default:
             std::cerr << "Error: unknown statement type" << std::endl;
             exit(1);
@@ -197,23 +509,85 @@ public:
 
     // Run a while statement
     void runWhileStatement(AstNode* statement, Scope* scope) {
-        // Evaluate the condition
-        bool condition = static_cast<bool>(evaluateExpression(statement->left, scope));
-
-        // Run the loop body
-        while (condition) {
+        // Run the loop body while the condition holds
+        while (static_cast<bool>(evaluateExpression(statement->left, scope))) {
             runStatement(statement->right, scope);
-            condition = static_cast<bool>(evaluateExpression(statement->left, scope));
+            if (endIteration()) {
+                break;
+            }
+            loopBackedge();
+        }
+    }
+
+    // Run a loop statement; the body block is in statement->left
+    void runLoopStatement(AstNode* statement, Scope* scope) {
+        while (true) {
+            runBlock(statement->left, scope);
+            if (endIteration()) {
+                break;
+            }
+            loopBackedge();
+        }
+    }
+
+    // Consume the control signal at the end of a loop iteration; true when the
+    // loop must exit. Returns and tail calls keep propagating to the function.
+    bool endIteration() {
+        if (control_ == CONTROL_BREAK || control_ == CONTROL_CONTINUE) {
+            bool exit = control_ == CONTROL_BREAK;
+            control_ = CONTROL_NONE;
+            return exit;
         }
+        return control_ != CONTROL_NONE;
+    }
+
+    // Safepoint taken once per loop iteration
+    void loopBackedge() {
+        chargeInstruction();
     }
 
     // Run a function declaration
     void runFunctionDeclaration(AstNode* statement, Scope* scope) {
-        // Create a new function
-        Function* function = new Function(statement->left->value, statement->right);
+        // Create a new function; it is freed again if it exceeds the heap limit
+        std::unique_ptr<Function> function(new (heap_) Function(statement->left->value, statement->right));
+        chargeHeap();
 
-        // Add the function to the scope
-        scope->addFunction(function);
+        // Add the function to the scope; a redeclaration replaces and frees the previous function
+        scope->addFunction(function.release());
+    }
+
+    // Run a return statement; the optional value expression is in statement->left.
+    // "return f(...)" inside a function becomes a tail call that reuses the caller's frame.
+    void runReturnStatement(AstNode* statement, Scope* scope) {
+        AstNode* expression = statement->left;
+        if (expression != nullptr && expression->type == AST_NODE_FUNCTION_CALL && stats_.callDepth > 0) {
+            Function* function = lookupFunction(expression->left->value, scope);
+            if (!function->isNative()) {
+                // Evaluate the arguments in the current scope before it is reused. An argument
+                // can itself make a tail call, which pushes and consumes its own arguments
+                // above these, so each tail call only owns the entries from its start index.
+                size_t start = tailArgs_.size();
+                for (AstNode* parameter = expression->right; parameter != nullptr; parameter = parameter->right) {
+                    tailArgs_.emplace_back(parameter->value, evaluateExpression(parameter->left, scope));
+                }
+                tailArgsStart_ = start;
+                tailFunction_ = function;
+                control_ = CONTROL_TAIL_CALL;
+                return;
+            }
+        }
+
+        scope->setLastValue(expression != nullptr ? evaluateExpression(expression, scope) : Value());
+        control_ = CONTROL_RETURN;
+    }
+
+    // Find a function in the current scope, then in the global scope
+    Function* lookupFunction(const std::string& name, Scope* scope) {
+        Function* function = scope->findFunction(name);
+        if (function == nullptr) {
+            function = globals_->getFunction(name);
+        }
+        return function;
     }
 
     // Run an expression statement
@@ -241,34 +615,323 @@ public:
     // Call a function
     Value callFunction(AstNode* expression, Scope* scope) {
         // Get the function
-        Function* function = scope->getFunction(expression->left->value);
+        Function* function = lookupFunction(expression->left->value, scope);
+
+        // Safepoint at every call
+        chargeInstruction();
 
-        // Create a new scope for the function
-        Scope* functionScope = new Scope();
+        if (function->isNative()) {
+            return callNativeFunction(function, expression, scope);
+        }
 
-        // Add the function's parameters to the scope
+        // Nothing can capture a call scope (functions hold only their AST),
+        // so it never escapes the call and lives in this C++ frame
+        enterCall();
+        Scope functionScope;
+
+        // Add the function's parameters to the scope; each argument node holds
+        // the parameter name in value, its expression in left and the next argument in right.
+        // Argument values are moved straight into the scope without copying.
         for (AstNode* parameter = expression->right; parameter != nullptr; parameter = parameter->right) {
-            functionScope->addVariable(parameter->left->value, evaluateExpression(parameter->right, scope));
+            functionScope.addVariable(parameter->value, evaluateExpression(parameter->left, scope));
         }
 
-        // Run the function's body
-        Value returnValue = runFunctionBody(function->getBody(), functionScope);
+        // Run the function's body. A tail call rebinds this frame to the callee
+        // and loops, so tail recursion runs in constant C++ and scope memory.
+        // A callee declared in this frame is pinned so clearing the frame does not free it.
+        std::unique_ptr<Function> pinned;
+        Value returnValue;
+        while (true) {
+            returnValue = runFunctionBody(function->getBody(), &functionScope);
+            if (control_ != CONTROL_TAIL_CALL) {
+                break;
+            }
+            control_ = CONTROL_NONE;
+            chargeInstruction();
+
+            function = tailFunction_;
+            std::unique_ptr<Function> callee(functionScope.takeFunction(function));
+            if (callee != nullptr) {
+                pinned = std::move(callee);
+            }
+
+            functionScope.clear();
+            for (size_t i = tailArgsStart_; i < tailArgs_.size(); ++i) {
+                functionScope.addVariable(tailArgs_[i].first, std::move(tailArgs_[i].second));
+            }
+            tailArgs_.resize(tailArgsStart_);
+        }
 
-        // Delete the function scope
-        delete functionScope;
+        // Functions declared in the call are freed with its scope
+        --stats_.callDepth;
 
         return returnValue;
     }
 
+    // Call a host function with its arguments evaluated into a fixed-size array
+    Value callNativeFunction(Function* function, AstNode* expression, Scope* scope) {
+        Value args[MAX_NATIVE_ARGS];
+        size_t count = 0;
+        AstNode* parameter = expression->right;
+        for (; parameter != nullptr && count < function->getArity(); parameter = parameter->right) {
+            args[count++] = evaluateExpression(parameter->left, scope);
+        }
+
+        // Check for missing or extra arguments; the host can catch this from Runtime::run
+        if (parameter != nullptr || count != function->getArity()) {
+            throw std::runtime_error("Error: wrong number of arguments to " + function->getName());
+        }
+
+        return function->getNative()(args);
+    }
+
     // Run a function body
     Value runFunctionBody(AstNode* body, Scope* scope) {
         // Run each statement in the body
-        for (AstNode* statement = body->left; statement != nullptr; statement = statement->right) {
-            runStatement(statement, scope);
+        runBlock(body, scope);
+        if (control_ != CONTROL_TAIL_CALL) {
+            control_ = CONTROL_NONE;
         }
 
         // Return the last value
         return scope->getLastValue();
     }
+
+private:
+    // Number of instructions between deadline and interrupt polls
+    static constexpr uint64_t LIMIT_CHECK_INTERVAL = 1024;
+
+    // Reset per-run statistics and arm the limits
+    void startRun() {
+        stats_.instructions = 0;
+        stats_.elapsedMilliseconds = 0;
+        stats_.callDepth = 0;
+        stats_.peakCallDepth = 0;
+        AllocationStats heap = heap_.getStats();
+        runStartAllocations_ = totalAllocations(heap);
+        stats_.heapBytes = heap.bytes;
+        stats_.peakHeapBytes = heap.bytes;
+        stats_.heapAllocations = 0;
+        startTime_ = std::chrono::steady_clock::now();
+        nextCheck_ = 0;
+        interruptRequested_.store(false, std::memory_order_relaxed);
+    }
+
+    // Charge one unit of fuel; the fast path is a single compare.
+    // Defining LUNA_NO_LIMIT_CHECKS removes it, as a baseline for bench/limits.cpp.
+    void chargeInstruction() {
+#ifndef LUNA_NO_LIMIT_CHECKS
+        if (++stats_.instructions >= nextCheck_) {
+            checkLimits();
+        }
+#endif
+    }
+
+    // Slow path: check fuel, deadline and interrupts, then schedule the next check
+    void checkLimits() {
+        if (limits_.maxInstructions != 0 && stats_.instructions > limits_.maxInstructions) {
+            fail(LIMIT_INSTRUCTIONS, "instruction limit exceeded");
+        }
+        if (interruptRequested_.load(std::memory_order_relaxed)) {
+            interruptRequested_.store(false, std::memory_order_relaxed);
+            fail(LIMIT_INTERRUPT, "execution interrupted");
+        }
+        if (limits_.maxMilliseconds != 0 && elapsedMilliseconds() > limits_.maxMilliseconds) {
+            fail(LIMIT_DEADLINE, "deadline exceeded");
+        }
+
+        nextCheck_ = stats_.instructions + LIMIT_CHECK_INTERVAL;
+        if (limits_.maxInstructions != 0 && nextCheck_ > limits_.maxInstructions + 1) {
+            nextCheck_ = limits_.maxInstructions + 1;
+        }
+    }
+
+    // Track entry into a function call
+    void enterCall() {
+        if (++stats_.callDepth > stats_.peakCallDepth) {
+            stats_.peakCallDepth = stats_.callDepth;
+        }
+        if (limits_.maxCallDepth != 0 && stats_.callDepth > limits_.maxCallDepth) {
+            fail(LIMIT_CALL_DEPTH, "call depth limit exceeded");
+        }
+    }
+
+    // Check the heap limit after an allocation from the runtime's heap;
+    // the caller frees the new object if this throws
+    void chargeHeap() {
+        sampleHeap();
+        if (limits_.maxHeapBytes != 0 && stats_.heapBytes > limits_.maxHeapBytes) {
+            fail(LIMIT_HEAP, "heap limit exceeded");
+        }
+    }
+
+    // Update the heap figures in the stats from the runtime's allocator
+    void sampleHeap() {
+        AllocationStats heap = heap_.getStats();
+        stats_.heapBytes = heap.bytes;
+        stats_.heapAllocations = totalAllocations(heap) - runStartAllocations_;
+        stats_.peakHeapBytes = std::max(stats_.peakHeapBytes, heap.bytes);
+    }
+
+    // Allocations of every kind counted by the allocator
+    static size_t totalAllocations(const AllocationStats& heap) {
+        size_t total = 0;
+        for (size_t i = 0; i < ALLOC_KIND_COUNT; ++i) {
+            total += heap.totalCounts[i];
+        }
+        return total;
+    }
+
+    // Milliseconds since the current run started
+    uint64_t elapsedMilliseconds() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime_).count();
+    }
+
+    // Terminate the current run
+    [[noreturn]] void fail(LimitKind kind, const std::string& message) {
+        stats_.elapsedMilliseconds = elapsedMilliseconds();
+        throw ExecutionLimitError(kind, "Error: " + message, stats_);
+    }
+
+    // Snapshot file header
+    static constexpr char SNAPSHOT_MAGIC[8] = { 'L', 'U', 'N', 'A', 'S', 'N', 'A', 'P' };
+    static constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+    // Deepest left-nesting of AST nodes accepted from a snapshot
+    static constexpr size_t MAX_SNAPSHOT_DEPTH = 1024;
+
+    // Write a little-endian 32-bit integer
+    static void writeInt(std::ostream& out, uint32_t value) {
+        unsigned char bytes[4] = {
+            static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8),
+            static_cast<unsigned char>(value >> 16), static_cast<unsigned char>(value >> 24)
+        };
+        out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    }
+
+    // Read a little-endian 32-bit integer
+    static uint32_t readInt(std::istream& in) {
+        unsigned char bytes[4] = { 0, 0, 0, 0 };
+        in.read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    // Write a length-prefixed string
+    static void writeString(std::ostream& out, const std::string& value) {
+        writeInt(out, static_cast<uint32_t>(value.size()));
+        out.write(value.data(), value.size());
+    }
+
+    // Read a length-prefixed string
+    static std::string readString(std::istream& in) {
+        uint32_t size = readInt(in);
+        std::string value;
+        while (in && value.size() < size) {
+            char buffer[4096];
+            size_t chunk = std::min<size_t>(sizeof(buffer), size - value.size());
+            if (!in.read(buffer, chunk)) {
+                break;
+            }
+            value.append(buffer, chunk);
+        }
+        return value;
+    }
+
+    // Write an AST subtree in pre-order, using a marker byte for null children.
+    // Statement lists are chained through right, so that side is walked iteratively.
+    static void writeNode(std::ostream& out, AstNode* node) {
+        for (; node != nullptr; node = node->right) {
+            out.put(1);
+            writeInt(out, static_cast<uint32_t>(node->type));
+            writeString(out, node->value);
+            writeNode(out, node->left);
+        }
+        out.put(0);
+    }
+
+    // Read an AST subtree written by writeNode; every node is owned by nodes.
+    // Fails the stream on an unknown node type or nesting beyond MAX_SNAPSHOT_DEPTH.
+    static AstNode* readNode(std::istream& in, std::vector<std::unique_ptr<AstNode>>& nodes, size_t depth) {
+        AstNode* first = nullptr;
+        AstNode** link = &first;
+        while (in.get() == 1 && in) {
+            uint32_t type = readInt(in);
+            if (type > AST_NODE_RETURN_STATEMENT || depth >= MAX_SNAPSHOT_DEPTH) {
+                in.setstate(std::ios::failbit);
+                break;
+            }
+            nodes.emplace_back(new AstNode());
+            AstNode* node = nodes.back().get();
+            node->type = static_cast<AstNodeType>(type);
+            node->value = readString(in);
+            node->left = readNode(in, nodes, depth + 1);
+            node->right = nullptr;
+            *link = node;
+            link = &node->right;
+        }
+        return first;
+    }
+
+    // Check whether a node can be used in an expression
+    static bool isExpression(const AstNode* node) {
+        return node != nullptr && (node->type == AST_NODE_LITERAL || node->type == AST_NODE_IDENTIFIER || node->type == AST_NODE_FUNCTION_CALL);
+    }
+
+    // Check that a node has the children its type requires when it runs
+    static bool hasValidShape(const AstNode* node) {
+        switch (node->type) {
+        case AST_NODE_IF_STATEMENT:
+            return isExpression(node->left) && node->right != nullptr && node->right->left != nullptr && node->right->right != nullptr;
+        case AST_NODE_WHILE_STATEMENT:
+            return isExpression(node->left) && node->right != nullptr;
+        case AST_NODE_FUNCTION_DECLARATION:
+            return node->left != nullptr && node->right != nullptr;
+        case AST_NODE_EXPRESSION_STATEMENT:
+            return isExpression(node->left);
+        case AST_NODE_LOOP_STATEMENT:
+            return node->left != nullptr;
+        case AST_NODE_RETURN_STATEMENT:
+            return node->left == nullptr || isExpression(node->left);
+        case AST_NODE_FUNCTION_CALL:
+            if (node->left == nullptr) {
+                return false;
+            }
+            for (const AstNode* argument = node->right; argument != nullptr; argument = argument->right) {
+                if (!isExpression(argument->left)) {
+                    return false;
+                }
+            }
+            return true;
+        default:
+            return true;
+        }
+    }
+
+    // Slab pools for this runtime's scopes and functions; declared before
+    // globals_ so it is constructed first and destroyed last
+    SlabAllocator heap_;
+
+    // Global scope shared by every run
+    Scope* globals_;
+
+    // AST nodes restored by the last loadSnapshot, referenced by global function bodies
+    std::vector<std::unique_ptr<AstNode>> snapshotNodes_;
+
+    // Pending break/continue/return for the innermost loop or function
+    ControlSignal control_;
+
+    // Callee of a pending tail call, and a stack of evaluated tail call arguments
+    // whose entries from tailArgsStart_ belong to the pending call
+    Function* tailFunction_;
+    std::vector<std::pair<std::string, Value>> tailArgs_;
+    size_t tailArgsStart_;
+
+    // Resource limits and usage
+    ExecutionLimits limits_;
+    ExecutionStats stats_;
+    size_t runStartAllocations_;
+    uint64_t nextCheck_;
+    std::chrono::steady_clock::time_point startTime_;
+    std::atomic<bool> interruptRequested_;
 };
 
@@ -0,0 +1,25 @@
+// check.h
+//
+// Minimal assertion helpers for the regression checks in this directory.
+
+#pragma once
+
+#include <iostream>
+
+static int failures = 0;
+
+// Report a failed check
+inline void check(bool condition, const char* description) {
+    if (!condition) {
+        std::cerr << "FAILED: " << description << std::endl;
+        ++failures;
+    }
+}
+
+// Print a summary and return the process exit code
+inline int finish(const char* name) {
+    if (failures == 0) {
+        std::cout << name << ": all checks passed" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+// limits.cpp
+//
+// Checks that each execution limit stops a script with the right LimitKind
+// and leaves the runtime able to run again.
+
+#include <thread>
+#include "../bench/bench.h"
+#include "check.h"
+
+// Run program and return the kind of limit it hit, or -1 if it finished
+int runToLimit(Runtime& runtime, AstNode* program) {
+    try {
+        runtime.run(program);
+    }
+    catch (const ExecutionLimitError& e) {
+        return e.getKind();
+    }
+    return -1;
+}
+
+// Check that the runtime still runs a call to "ok" after a limit stopped it
+void checkRunsAgain(Runtime& runtime, AstBuilder& ast, const char* description) {
+    runtime.setLimits(ExecutionLimits());
+    bool finished = runToLimit(runtime, ast.block({ ast.expressionStatement(ast.call("ok")) })) == -1;
+    check(finished && runtime.getStats().callDepth == 0, description);
+}
+
+int main() {
+    AstBuilder ast;
+    Runtime runtime;
+    ast.declare(runtime, "ok", ast.block({ ast.returnStatement(ast.literal("1")) }));
+
+    // loop 1 end, which never finishes on its own
+    AstNode* forever = ast.block({ ast.loopStatement(ast.block({ ast.expressionStatement(ast.literal("1")) })) });
+
+    // Fuel
+    ExecutionLimits limits = {};
+    limits.maxInstructions = 10000;
+    runtime.setLimits(limits);
+    check(runToLimit(runtime, forever) == LIMIT_INSTRUCTIONS, "fuel stops an endless loop");
+    check(runtime.getStats().instructions > limits.maxInstructions, "fuel error reports the instructions used");
+    checkRunsAgain(runtime, ast, "runtime runs again after running out of fuel");
+
+    // Deadline
+    limits = {};
+    limits.maxMilliseconds = 20;
+    runtime.setLimits(limits);
+    check(runToLimit(runtime, forever) == LIMIT_DEADLINE, "deadline stops an endless loop");
+    checkRunsAgain(runtime, ast, "runtime runs again after its deadline");
+
+    // Heap: declaring a function needs more than the bytes already in use
+    limits = {};
+    limits.maxHeapBytes = runtime.getAllocationStats().bytes + 1;
+    runtime.setLimits(limits);
+    size_t liveFunctions = runtime.getAllocationStats().liveCounts[ALLOC_FUNCTION];
+    AstNode* declare = ast.block({ ast.functionDeclaration("extra", ast.block({ ast.returnStatement(ast.literal("1")) })) });
+    check(runToLimit(runtime, declare) == LIMIT_HEAP, "heap cap stops a function declaration");
+    check(runtime.getAllocationStats().liveCounts[ALLOC_FUNCTION] == liveFunctions, "function over the heap cap is freed");
+    checkRunsAgain(runtime, ast, "runtime runs again after its heap cap");
+
+    // Call depth: func deep() deep() return 1 end
+    ast.declare(runtime, "deep", ast.block({ ast.expressionStatement(ast.call("deep")), ast.returnStatement(ast.literal("1")) }));
+    limits = {};
+    limits.maxCallDepth = 50;
+    runtime.setLimits(limits);
+    check(runToLimit(runtime, ast.block({ ast.expressionStatement(ast.call("deep")) })) == LIMIT_CALL_DEPTH, "call depth cap stops runaway recursion");
+    check(runtime.getStats().peakCallDepth == limits.maxCallDepth + 1, "call depth error reports the depth reached");
+    checkRunsAgain(runtime, ast, "runtime runs again after its call depth cap");
+
+    // No call depth cap by default: func nest() if more() then return id(v = nest()) else return "1" end
+    bindFunction<&Countdown::next>(runtime, "more");
+    ast.declare(runtime, "id", ast.block({ ast.returnStatement(ast.identifier("v")) }));
+    ast.declare(runtime, "nest", ast.block({ ast.node(AST_NODE_IF_STATEMENT, "", ast.call("more"), ast.node(AST_NODE_LITERAL, "",
+        ast.returnStatement(ast.call("id", { { "v", ast.call("nest") } })),
+        ast.returnStatement(ast.literal("1")))) }));
+    runtime.setLimits(ExecutionLimits());
+    Countdown::remaining = 2000;
+    check(runToLimit(runtime, ast.block({ ast.expressionStatement(ast.call("nest")) })) == -1, "zero call depth limit is unlimited");
+    check(runtime.getStats().peakCallDepth == 2001, "uncapped recursion reports its depth");
+
+    // Interrupt from another thread; the deadline only keeps a lost interrupt from hanging the check
+    limits = {};
+    limits.maxMilliseconds = 10000;
+    runtime.setLimits(limits);
+    std::thread watchdog([&runtime]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        runtime.requestInterrupt();
+    });
+    int kind = runToLimit(runtime, forever);
+    watchdog.join();
+    check(kind == LIMIT_INTERRUPT, "interrupt stops an endless loop");
+    checkRunsAgain(runtime, ast, "runtime runs again after an interrupt");
+
+    // An interrupt requested between runs does not stop the next one
+    runtime.requestInterrupt();
+    checkRunsAgain(runtime, ast, "interrupt requested between runs is discarded");
+
+    return finish("limits");
+}
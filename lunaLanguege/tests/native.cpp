@@ -0,0 +1,46 @@
+// native.cpp
+//
+// Checks for calling native functions bound with bindFunction.
+
+#include "../bench/bench.h"
+#include "check.h"
+
+int add(int a, int b) {
+    return a + b;
+}
+
+// Run a single call statement and return the error message, or "" if it succeeded
+std::string runCall(Runtime& runtime, AstNode* call) {
+    AstBuilder ast;
+    try {
+        runtime.run(ast.block({ ast.expressionStatement(call) }));
+    }
+    catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "";
+}
+
+int main() {
+    AstBuilder ast;
+    Runtime runtime;
+    bindFunction<&add>(runtime, "add");
+
+    AstNode* good = ast.call("add", { { "a", ast.literal("40") }, { "b", ast.literal("2") } });
+    check(runtime.evaluateExpression(good, runtime.getGlobals()).getValue() == "42", "native add returns the sum");
+
+    // Wrong argument counts are errors the host can catch
+    check(runCall(runtime, ast.call("add", { { "a", ast.literal("1") } })) == "Error: wrong number of arguments to add",
+        "too few arguments throw");
+    check(runCall(runtime, ast.call("add", { { "a", ast.literal("1") }, { "b", ast.literal("2") }, { "c", ast.literal("3") } }))
+        == "Error: wrong number of arguments to add", "too many arguments throw");
+
+    // So are arguments that do not convert exactly
+    check(runCall(runtime, ast.call("add", { { "a", ast.literal("abc") }, { "b", ast.literal("2") } })) == "Error: cannot convert \"abc\" to int",
+        "non-numeric argument throws");
+    check(runCall(runtime, ast.call("add", { { "a", ast.literal("1.5") }, { "b", ast.literal("2") } })) == "Error: cannot convert \"1.5\" to int",
+        "fractional argument to an int throws");
+
+    check(runCall(runtime, good).empty() && runtime.getStats().callDepth == 0, "runtime runs again after a native call error");
+    return finish("native");
+}
@@ -0,0 +1,47 @@
+// parser.cpp
+//
+// Checks for eager and lazy parsing of function bodies.
+
+#include <sstream>
+#include "../parser.cpp"
+#include "check.h"
+
+// Parse source and return the text the parser produced, or "error" if it threw
+std::string parse(const std::string& source, bool lazyFunctions) {
+    std::ostringstream output;
+    Parser parser(source, lazyFunctions);
+    parser.setOutput(output);
+    try {
+        parser.parse();
+    }
+    catch (const std::runtime_error&) {
+        return "error";
+    }
+    return output.str();
+}
+
+// The body of f calls g, so "Function call: g" shows whether the body was parsed
+bool parsedBody(const std::string& output) {
+    return output.find("Function call: g") != std::string::npos;
+}
+
+int main() {
+    // Eager mode parses every body at its declaration
+    check(parsedBody(parse("func f g() end", false)), "eager mode parses an uncalled body");
+    check(parse("func f let end", false) == "error", "eager mode reports an error in an uncalled body");
+
+    // Lazy mode parses a body only once a call to it has been parsed
+    check(!parsedBody(parse("func f g() end", true)), "lazy mode skips an uncalled body");
+    check(parse("func f let end", true) != "error", "lazy mode does not parse an uncalled body with an error");
+    check(parsedBody(parse("func f g() end f()", true)), "lazy mode parses a body at its first call");
+    check(parsedBody(parse("f() func f g() end", true)), "lazy mode parses a body called before its declaration");
+    check(parse("func f let end f()", true) == "error", "lazy mode reports an error in a called body");
+
+    // A body is parsed once however often it is called
+    std::string twice = parse("func f g() end f() f()", true);
+    check(twice.find("Function call: g") == twice.rfind("Function call: g"), "lazy mode parses a body only once");
+
+    // Unbalanced "end" keywords are still caught when the body is skipped
+    check(parse("func f if x then g() end", true) == "error", "lazy mode reports a missing 'end'");
+    return finish("parser");
+}
@@ -0,0 +1,81 @@
+// snapshot.cpp
+//
+// Checks for saving and restoring a runtime's global scope.
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include "../bench/bench.h"
+#include "check.h"
+
+// Path for a scratch snapshot file
+std::string snapshotPath(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream out(path, std::ios::binary);
+    out << contents;
+}
+
+// Save a runtime holding one function f with the given body
+std::string saveFunction(const char* name, AstNode* body) {
+    Runtime runtime;
+    runtime.getGlobals()->addFunction(new (runtime.getHeap()) Function("f", body));
+    std::string path = snapshotPath(name);
+    runtime.saveSnapshot(path);
+    return path;
+}
+
+int main() {
+    AstBuilder ast;
+
+    // Variables and functions survive a round trip
+    Runtime source;
+    source.getGlobals()->addVariable("x", Value("5"));
+    ast.declare(source, "f", ast.block({ ast.returnStatement(ast.call("g", { { "v", ast.literal("42") } })) }));
+    ast.declare(source, "g", ast.block({ ast.returnStatement(ast.identifier("v")) }));
+    std::string path = snapshotPath("luna_snapshot_good.snap");
+    check(source.saveSnapshot(path), "snapshot is saved");
+
+    Runtime restored;
+    check(restored.loadSnapshot(path), "snapshot is loaded");
+    check(restored.getGlobals()->getVariable("x").getValue() == "5", "variable is restored");
+    check(restored.evaluateExpression(ast.call("f"), restored.getGlobals()).getValue() == "42", "function is restored and runs");
+    check(restored.loadSnapshot(path), "snapshot loads again over a restored one");
+
+    // A truncated file is rejected and leaves the current globals in place
+    std::string contents = readFile(path);
+    std::string truncatedPath = snapshotPath("luna_snapshot_truncated.snap");
+    writeFile(truncatedPath, contents.substr(0, contents.size() / 2));
+    check(!restored.loadSnapshot(truncatedPath), "truncated snapshot is rejected");
+    check(restored.evaluateExpression(ast.call("f"), restored.getGlobals()).getValue() == "42", "globals survive a rejected snapshot");
+
+    // An unknown node type is rejected. With no variables, f's first node
+    // type follows the header, both counts, the name "f" and a marker byte.
+    std::string corruptPath = saveFunction("luna_snapshot_type.snap", ast.block({ ast.returnStatement(ast.literal("1")) }));
+    std::string corrupt = readFile(corruptPath);
+    corrupt[8 + 4 + 4 + 4 + 4 + 1 + 1] = 99;
+    writeFile(corruptPath, corrupt);
+    check(!restored.loadSnapshot(corruptPath), "unknown node type is rejected");
+
+    // Nodes missing children the runtime needs are rejected
+    AstNode* nameless = ast.node(AST_NODE_FUNCTION_CALL);
+    check(!restored.loadSnapshot(saveFunction("luna_snapshot_call.snap", ast.block({ ast.expressionStatement(nameless) }))),
+        "call without a function name is rejected");
+    AstNode* branchless = ast.node(AST_NODE_IF_STATEMENT, "", ast.literal("1"));
+    check(!restored.loadSnapshot(saveFunction("luna_snapshot_if.snap", ast.block({ branchless }))),
+        "if statement without branches is rejected");
+    check(!restored.loadSnapshot(saveFunction("luna_snapshot_body.snap", nullptr)), "function without a body is rejected");
+
+    for (const char* name : { "luna_snapshot_good.snap", "luna_snapshot_truncated.snap", "luna_snapshot_type.snap",
+        "luna_snapshot_call.snap", "luna_snapshot_if.snap", "luna_snapshot_body.snap" }) {
+        std::filesystem::remove(snapshotPath(name));
+    }
+    return finish("snapshot");
+}
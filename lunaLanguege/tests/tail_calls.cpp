@@ -0,0 +1,100 @@
+// tail_calls.cpp
+//
+// Regression checks for tail calls made with "return f(...)".
+
+#include "../bench/bench.h"
+#include "check.h"
+
+static Runtime* runtime = nullptr;
+static size_t liveFunctions = 0;
+
+// Native hook recording how many functions are alive while a script runs
+void recordLiveFunctions() {
+    liveFunctions = runtime->getAllocationStats().liveCounts[ALLOC_FUNCTION];
+}
+
+// A tail call to a function declared in the caller's frame must keep the
+// callee alive after the frame is cleared for reuse:
+//
+//     func f()
+//         loop func g(x) recordLiveFunctions() return x end break end
+//         return g(x = "7")
+//     end
+void checkCalleeDeclaredInFrame() {
+    AstBuilder ast;
+    Runtime local;
+    runtime = &local;
+    bindFunction<&recordLiveFunctions>(local, "recordLiveFunctions");
+
+    AstNode* record = ast.expressionStatement(ast.call("recordLiveFunctions"));
+    record->right = ast.returnStatement(ast.identifier("x"));
+
+    // The declaration's right is both g's body and the next statement of the
+    // loop body, so the body is carried by a break that ends the loop
+    AstNode* declaration = ast.functionDeclaration("g", ast.breakStatement(record));
+    ast.declare(local, "f", ast.block({
+        ast.loopStatement(ast.block({ declaration })),
+        ast.returnStatement(ast.call("g", { { "x", ast.literal("7") } }))
+    }));
+
+    size_t globalFunctions = local.getGlobals()->getFunctions().size();
+    Value result = local.evaluateExpression(ast.call("f"), local.getGlobals());
+    check(result.getValue() == "7", "tail callee declared in the frame returns its argument");
+    check(liveFunctions == globalFunctions + 1, "tail callee declared in the frame is alive while it runs");
+    check(local.getAllocationStats().liveCounts[ALLOC_FUNCTION] == globalFunctions, "tail callee is freed when the call returns");
+}
+
+// A tail call made while evaluating another tail call's arguments must not
+// drop the arguments already evaluated:
+//
+//     func id(v) return v end
+//     func b() return id(v = "7") end
+//     func two(a, c) return a end
+//     func f() return two(a = "first", c = b()) end
+void checkNestedTailCallInArguments() {
+    AstBuilder ast;
+    Runtime local;
+    ast.declare(local, "id", ast.block({ ast.returnStatement(ast.identifier("v")) }));
+    ast.declare(local, "b", ast.block({ ast.returnStatement(ast.call("id", { { "v", ast.literal("7") } })) }));
+    ast.declare(local, "two", ast.block({ ast.returnStatement(ast.identifier("a")) }));
+    ast.declare(local, "pickC", ast.block({ ast.returnStatement(ast.identifier("c")) }));
+    ast.declare(local, "f", ast.block({
+        ast.returnStatement(ast.call("two", { { "a", ast.literal("first") }, { "c", ast.call("b") } }))
+    }));
+    ast.declare(local, "g", ast.block({
+        ast.returnStatement(ast.call("pickC", { { "a", ast.literal("first") }, { "c", ast.call("b") } }))
+    }));
+
+    check(local.evaluateExpression(ast.call("f"), local.getGlobals()).getValue() == "first", "argument before a nested tail call is kept");
+    check(local.evaluateExpression(ast.call("g"), local.getGlobals()).getValue() == "7", "nested tail call result is passed as an argument");
+}
+
+// Tail recursion runs in constant space, however deep it goes:
+//
+//     func down() if more() then return down() else return "done" end
+void checkDeepTailRecursion() {
+    const long long DEPTH = 10000000;
+    AstBuilder ast;
+    Runtime local;
+    bindFunction<&Countdown::next>(local, "more");
+
+    // The branches return, so the if's right is never taken as a next statement
+    ast.declare(local, "down", ast.block({ ast.node(AST_NODE_IF_STATEMENT, "", ast.call("more"), ast.node(AST_NODE_LITERAL, "",
+        ast.returnStatement(ast.call("down")),
+        ast.returnStatement(ast.literal("done")))) }));
+
+    AllocationStats before = local.getAllocationStats();
+    Countdown::remaining = DEPTH;
+    local.run(ast.block({ ast.expressionStatement(ast.call("down")) }));
+    AllocationStats after = local.getAllocationStats();
+    check(Countdown::remaining < 0, "tail recursion runs to the full depth");
+    check(local.getStats().peakCallDepth == 1, "tail recursion never nests a call");
+    check(local.getStats().heapAllocations == 0 && after.bytes == before.bytes, "tail recursion allocates nothing from the runtime heap");
+}
+
+int main() {
+    checkCalleeDeclaredInFrame();
+    checkNestedTailCallInArguments();
+    checkDeepTailRecursion();
+    return finish("tail_calls");
+}